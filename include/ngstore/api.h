@@ -89,7 +89,9 @@ typedef int (*ngsProgressFunc)(enum ngsCode status, double complete,
 /**
  * @brief Prototype of function, which executed when changes occurred.
  * @param uri Catalog path (for features/rows ended with feature ID, for
- * attachments ended with attachments/{int:id}).
+ * attachments ended with attachments/{int:id}). Bulk insert by
+ * ngsFeatureClassInsertFeatures reports CC_CREATE_FEATURE once with the table
+ * path without feature ID, so the whole table should be reloaded.
  * @param operation Operation which trigger notification.
  */
 typedef void (*ngsNotifyFunc)(const char* uri, enum ngsChangeCode operation);
@@ -249,6 +251,7 @@ NGS_EXTERNC int ngsDatasetOpen(CatalogObjectH object, unsigned int openFlags,
                                char** openOptions);
 NGS_EXTERNC char ngsDatasetIsOpened(CatalogObjectH object);
 NGS_EXTERNC int ngsDatasetClose(CatalogObjectH object);
+NGS_EXTERNC long long ngsDatasetSQLLockContentionCount(CatalogObjectH object);
 
 NGS_EXTERNC ngsField* ngsFeatureClassFields(CatalogObjectH object);
 NGS_EXTERNC ngsGeometryType ngsFeatureClassGeometryType(CatalogObjectH object);
@@ -256,10 +259,14 @@ NGS_EXTERNC int ngsFeatureClassCreateOverviews(CatalogObjectH object,
                                                char** options,
                                                ngsProgressFunc callback,
                                                void* callbackData);
+NGS_EXTERNC int ngsFeatureClassFlushOverviews(CatalogObjectH object);
 NGS_EXTERNC FeatureH ngsFeatureClassCreateFeature(CatalogObjectH object);
 NGS_EXTERNC void ngsFeatureClassBatchMode(CatalogObjectH object, char enable);
 NGS_EXTERNC int ngsFeatureClassInsertFeature(CatalogObjectH object,
                                              FeatureH feature, char logEdits);
+NGS_EXTERNC int ngsFeatureClassInsertFeatures(CatalogObjectH object,
+                                              FeatureH* features, int count,
+                                              char logEdits);
 NGS_EXTERNC int ngsFeatureClassUpdateFeature(CatalogObjectH object,
                                              FeatureH feature, char logEdits);
 NGS_EXTERNC int ngsFeatureClassDeleteFeature(CatalogObjectH object, long long id,
@@ -306,6 +313,9 @@ NGS_EXTERNC void ngsFeatureSetFieldDateTime(FeatureH feature, int field, int yea
 
 NGS_EXTERNC FeatureH ngsStoreFeatureClassGetFeatureByRemoteId(
         CatalogObjectH object, long long rid);
+NGS_EXTERNC FeatureH* ngsStoreFeatureClassGetFeaturesByRemoteIds(
+        CatalogObjectH object, const long long* rids, int count);
+NGS_EXTERNC void ngsFeatureListFree(FeatureH* list);
 NGS_EXTERNC long long ngsStoreFeatureGetRemoteId(FeatureH feature);
 NGS_EXTERNC void ngsStoreFeatureSetRemoteId(FeatureH feature, long long rid);
 
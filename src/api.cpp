@@ -1363,6 +1363,36 @@ int ngsDatasetClose(CatalogObjectH object)
     return COD_SUCCESS;
 }
 
+/**
+ * @brief ngsDatasetSQLLockContentionCount Returns how many times the dataset
+ * SQL lock was waited for since open. Useful to tune the number of threads
+ * reading and writing the dataset.
+ * @param object Handle to dataset or to table or feature class in it
+ * @return Wait count or -1 on error
+ */
+long long ngsDatasetSQLLockContentionCount(CatalogObjectH object)
+{
+    Object* catalogObject = static_cast<Object*>(object);
+    if(!catalogObject) {
+        errorMessage(COD_INVALID, _("The object handle is null"));
+        return -1;
+    }
+
+    Dataset* dataset = dynamic_cast<Dataset*>(catalogObject);
+    if(!dataset) {
+        Table* table = getTableFromHandle(object);
+        if(table) {
+            dataset = dynamic_cast<Dataset*>(table->parent());
+        }
+    }
+    if(!dataset) {
+        errorMessage(COD_INVALID, _("Source dataset type is incompatible"));
+        return -1;
+    }
+
+    return static_cast<long long>(dataset->sqlLockContentionCount());
+}
+
 /**
  * @brief ngsFeatureClassFields Feature class fields
  * @param object Feature class handle
@@ -1429,9 +1459,20 @@ ngsGeometryType ngsFeatureClassGeometryType(CatalogObjectH object)
  * @brief ngsFeatureClassCreateOverviews Creates Gl optimized vector tiles
  * @param object Catalog object handle. Must be feature class or simple datasource.
  * @param options The options key-value array specific to operation.
+ * - FORCE - recreate overviews if already exist
+ * - ZOOM_LEVELS - comma separated values of zoom levels
+ * - COMPRESS_TILES - deflate stored tiles (default OFF)
+ * - MAX_MEMORY_MB - memory limit in megabytes for generated tiles. If
+ *   exceeded, the tiles are flushed to the overviews table and merged with
+ *   stored ones. 0 - no limit (default)
+ * - BOTTOM_UP - tile features only for the deepest zoom level and derive
+ *   other levels by merging child tiles snapped to the coarser grid. Faster,
+ *   but the result is less precise than per level tiling (default OFF)
  * @param callback The callback function to report or cancel process.
  * @param callbackData The callback function data.
- * @return ngsCode value - COD_SUCCESS if everything is OK
+ * @return ngsCode value - COD_SUCCESS if everything is OK, COD_CANCELED if
+ * the callback canceled the process. Canceled process removes the overviews,
+ * the feature class is tiled on the fly after that.
  */
 int ngsFeatureClassCreateOverviews(CatalogObjectH object, char** options,
                                    ngsProgressFunc callback, void* callbackData)
@@ -1443,8 +1484,23 @@ int ngsFeatureClassCreateOverviews(CatalogObjectH object, char** options,
 
     Options createOptions(options);
     Progress createProgress(callback, callbackData);
-    return featureClass->createOverviews(createProgress, createOptions) ?
-                COD_SUCCESS : COD_CREATE_FAILED;
+    return featureClass->createOverviews(createProgress, createOptions);
+}
+
+/**
+ * @brief ngsFeatureClassFlushOverviews Updates overview tiles affected by
+ * feature edits in batch mode. Executed automatically on batch mode finish.
+ * @param object Catalog object handle. Must be feature class.
+ * @return ngsCode value - COD_SUCCESS if everything is OK
+ */
+int ngsFeatureClassFlushOverviews(CatalogObjectH object)
+{
+    FeatureClass* featureClass = getFeatureClassFromHandle(object);
+    if(!featureClass) {
+        return COD_INVALID;
+    }
+
+    return featureClass->flushOverviews() ? COD_SUCCESS : COD_UPDATE_FAILED;
 }
 
 
@@ -1523,6 +1579,44 @@ int ngsFeatureClassInsertFeature(CatalogObjectH object, FeatureH feature,
                                                                      COD_INSERT_FAILED;
 }
 
+/**
+ * @brief ngsFeatureClassInsertFeatures Inserts features/rows into the table in
+ * one transaction. Either all features are inserted or none of them. Unlike
+ * ngsFeatureClassInsertFeature, the change is notified once by
+ * CC_CREATE_FEATURE with the table path without feature ID.
+ * @param object Handle to Table, FeatureClass or SimpleDataset catalog object
+ * @param features Array of features to insert
+ * @param count Features array size
+ * @param logEdits If log edit operation enabled this key can manage to log or
+ * not this edit operations
+ * @return COD_SUCCESS if everything is OK
+ */
+int ngsFeatureClassInsertFeatures(CatalogObjectH object, FeatureH* features,
+                                  int count, char logEdits)
+{
+    Table* table = getTableFromHandle(object);
+    if(nullptr == table) {
+        return COD_INVALID;
+    }
+
+    if(nullptr == features || count < 0) {
+        return errorMessage(COD_INVALID, _("The features array is empty"));
+    }
+
+    std::vector<FeaturePtr> featuresArray;
+    featuresArray.reserve(static_cast<size_t>(count));
+    for(int i = 0; i < count; ++i) {
+        FeaturePtr* featurePtrPointer = static_cast<FeaturePtr*>(features[i]);
+        if(nullptr == featurePtrPointer) {
+            return errorMessage(COD_INVALID, _("The feature %d is null"), i);
+        }
+        featuresArray.push_back(*featurePtrPointer);
+    }
+
+    return table->insertFeatures(featuresArray, logEdits == 1) ? COD_SUCCESS :
+                                                                 COD_INSERT_FAILED;
+}
+
 /**
  * @brief ngsFeatureClassUpdateFeature Update feature/row
  * @param object Handle to Table, FeatureClass or SimpleDataset catalog object
@@ -1899,6 +1993,57 @@ FeatureH ngsStoreFeatureClassGetFeatureByRemoteId(CatalogObjectH object,
     return nullptr;
 }
 
+/**
+ * @brief ngsStoreFeatureClassGetFeaturesByRemoteIds Finds features by remote
+ * identifiers in batches of thousands identifiers per query
+ * @param object Handle to store Table or FeatureClass catalog object
+ * @param rids Remote identifiers array
+ * @param count Remote identifiers array size
+ * @return Null terminated array of found features in arbitrary order or null.
+ * Free the array with ngsFeatureListFree.
+ */
+FeatureH* ngsStoreFeatureClassGetFeaturesByRemoteIds(CatalogObjectH object,
+                                                     const long long* rids,
+                                                     int count)
+{
+    StoreObject* storeObject = dynamic_cast<StoreObject*>(
+                getTableFromHandle(object));
+    if(!storeObject) {
+        errorMessage(COD_INVALID, _("Source dataset type is incompatible"));
+        return nullptr;
+    }
+    if(nullptr == rids || count <= 0) {
+        errorMessage(COD_INVALID, _("The remote identifiers array is empty"));
+        return nullptr;
+    }
+
+    std::vector<FeaturePtr> features = storeObject->getFeaturesByRemoteIds(
+                std::vector<GIntBig>(rids, rids + count));
+    FeatureH* out = static_cast<FeatureH*>(CPLMalloc((features.size() + 1) *
+                                                     sizeof(FeatureH)));
+    size_t counter = 0;
+    for(const FeaturePtr& feature : features) {
+        out[counter++] = new FeaturePtr(feature);
+    }
+    out[counter] = nullptr;
+    return out;
+}
+
+/**
+ * @brief ngsFeatureListFree Frees features array and all features in it
+ * @param list Null terminated features array
+ */
+void ngsFeatureListFree(FeatureH* list)
+{
+    if(nullptr == list) {
+        return;
+    }
+    for(FeatureH* feature = list; *feature != nullptr; ++feature) {
+        ngsFeatureFree(*feature);
+    }
+    CPLFree(list);
+}
+
 GeometryH ngsFeatureCreateGeometry(FeatureH feature)
 {
     FeaturePtr* featurePtrPointer = static_cast<FeaturePtr*>(feature);
@@ -2997,11 +3142,7 @@ int ngsLayerSetSelectionIds(LayerH layer, long long* ids, int size)
         return errorMessage(COD_UNSUPPORTED, _("Layer type is unsupported. Mast be GlFeatureLayer"));
     }
 
-    std::set<GIntBig> selectIds;
-    for(int i = 0; i < size; ++i) {
-        selectIds.insert(ids[i]);
-    }
-    renderLayerPtr->setSelectedIds(selectIds);
+    renderLayerPtr->setSelectedIds(FeatureIDs(ids, ids + size));
     return COD_SUCCESS;
 }
 
@@ -3016,11 +3157,7 @@ int ngsLayerSetHideIds(LayerH layer, long long* ids, int size)
         return errorMessage(COD_UNSUPPORTED, _("Layer type is unsupported. Mast be GlFeatureLayer"));
     }
 
-    std::set<GIntBig> hideIds;
-    for(int i = 0; i < size; ++i) {
-        hideIds.insert(ids[i]);
-    }
-    renderLayerPtr->setHideIds(hideIds);
+    renderLayerPtr->setHideIds(FeatureIDs(ids, ids + size));
     return COD_SUCCESS;
 }
 
@@ -211,14 +211,18 @@ Dataset::Dataset(ObjectContainer * const parent,
     DatasetBase(),
     m_addsDS(nullptr),
     m_metadata(nullptr),
-    m_executeSQLMutex(CPLCreateMutex())
+    m_readHandleGeneration(0),
+    m_readHandlesMutex(CPLCreateMutex())
 {
-    CPLReleaseMutex(m_executeSQLMutex);
+    CPLReleaseMutex(m_readHandlesMutex);
 }
 
 Dataset::~Dataset()
 {
-    CPLDestroyMutex(m_executeSQLMutex);
+    closeReadHandles();
+    CPLDestroyMutex(m_readHandlesMutex);
+    CPLDebug("ngstore", "SQL lock of %s waited " CPL_FRMT_GUIB " times",
+             m_name.c_str(), m_executeSQLLock.contentionCount());
     GDALClose(m_addsDS);
     m_addsDS = nullptr;
 }
@@ -291,7 +295,7 @@ Table* Dataset::createTable(const CPLString &name,
 
 bool Dataset::setProperty(const char* key, const char* value)
 {
-    CPLMutexHolder holder(m_executeSQLMutex);
+    ReadWriteLockHolder holder(&m_executeSQLLock);
 
     if(!m_addsDS) {
         createAdditionsDataset();
@@ -316,7 +320,7 @@ CPLString Dataset::property(const char* key, const char* defaultValue)
     if(!m_metadata)
         return defaultValue;
 
-    CPLMutexHolder holder(m_executeSQLMutex);
+    ReadWriteLockHolder holder(&m_executeSQLLock);
 
     m_metadata->SetAttributeFilter(CPLSPrintf("%s LIKE \"%s\"", META_KEY, key));
     OGRFeature* feature = m_metadata->GetNextFeature();
@@ -343,7 +347,7 @@ std::map<CPLString, CPLString> Dataset::getProperties(const char* table,
         name += CPLString(".") + domain;
     }
 
-    CPLMutexHolder holder(m_executeSQLMutex);
+    ReadWriteLockHolder holder(&m_executeSQLLock);
 
     m_metadata->SetAttributeFilter(CPLSPrintf("%s LIKE \"%s.%%\"", META_KEY, name.c_str()));
     FeaturePtr feature;
@@ -365,18 +369,95 @@ void Dataset::deleteProperties(const char* table)
                           METHADATA_TABLE_NAME, META_KEY, table));
 }
 
-void Dataset::lockExecuteSql(bool lock)
+void Dataset::lockExecuteSql(bool lock, bool shared)
 {
     if(lock) {
-        CPLAcquireMutex(m_executeSQLMutex, 15.0);
+        if(shared) {
+            m_executeSQLLock.lockShared();
+        }
+        else {
+            m_executeSQLLock.lock();
+        }
     }
     else {
-        CPLReleaseMutex(m_executeSQLMutex);
+        if(shared) {
+            m_executeSQLLock.unlockShared();
+        }
+        else {
+            m_executeSQLLock.unlock();
+        }
     }
 }
 
+GUIntBig Dataset::sqlLockContentionCount() const
+{
+    return m_executeSQLLock.contentionCount();
+}
+
+bool Dataset::canOpenReadHandles() const
+{
+    // SQLite connections to the same file can read in parallel
+    return isOpened() && !m_path.empty() &&
+            (type() == CAT_CONTAINER_NGS || type() == CAT_CONTAINER_GPKG);
+}
+
+GDALDataset* Dataset::acquireReadHandle()
+{
+    if(!canOpenReadHandles()) {
+        return nullptr;
+    }
+
+    CPLMutexHolder holder(m_readHandlesMutex);
+    if(!m_readHandles.empty()) {
+        GDALDataset* handle = m_readHandles.back();
+        m_readHandles.pop_back();
+        return handle;
+    }
+
+    GDALDataset* handle = static_cast<GDALDataset*>(
+                GDALOpenEx(m_path, GDAL_OF_VECTOR|GDAL_OF_READONLY, nullptr,
+                           nullptr, nullptr));
+    if(nullptr != handle) {
+        m_readHandleGenerations[handle] = m_readHandleGeneration;
+    }
+    return handle;
+}
+
+void Dataset::releaseReadHandle(GDALDataset* handle, bool reuse)
+{
+    if(nullptr == handle) {
+        return;
+    }
+
+    CPLMutexHolder holder(m_readHandlesMutex);
+    auto it = m_readHandleGenerations.find(handle);
+    // Handle opened before schema change must not be reused
+    if(reuse && it != m_readHandleGenerations.end() &&
+            it->second == m_readHandleGeneration) {
+        m_readHandles.push_back(handle);
+        return;
+    }
+
+    if(it != m_readHandleGenerations.end()) {
+        m_readHandleGenerations.erase(it);
+    }
+    GDALClose(handle);
+}
+
+void Dataset::closeReadHandles()
+{
+    CPLMutexHolder holder(m_readHandlesMutex);
+    for(GDALDataset* handle : m_readHandles) {
+        m_readHandleGenerations.erase(handle);
+        GDALClose(handle);
+    }
+    m_readHandles.clear();
+    m_readHandleGeneration++;
+}
+
 bool Dataset::destroyTable(Table* table)
 {
+    closeReadHandles();
     if(destroyTable(m_DS, table->m_layer)) {
         deleteProperties(table->name());
         notifyChanges();
@@ -388,6 +469,7 @@ bool Dataset::destroyTable(Table* table)
 bool Dataset::destroy()
 {
     clear();
+    closeReadHandles();
     GDALClose(m_DS);
     m_DS = nullptr;
     GDALClose(m_addsDS);
@@ -428,7 +510,7 @@ bool Dataset::destroy()
 char** Dataset::metadata(const char* domain) const {
     if(nullptr == m_DS)
         return nullptr;
-    CPLMutexHolder holder(m_executeSQLMutex);
+    ReadWriteLockHolder holder(&m_executeSQLLock);
     return m_DS->GetMetadata(domain);
 }
 
@@ -623,7 +705,8 @@ bool Dataset::destroyOverviewsTable(const char* name)
     OGRLayer* layer = m_addsDS->GetLayerByName(overviewsTableName(name));
     if(!layer)
         return false;
-    return destroyTable(m_DS, layer);
+    closeReadHandles();
+    return destroyTable(m_addsDS, layer);
 }
 
 bool Dataset::clearOverviewsTable(const char* name)
@@ -667,6 +750,9 @@ const char* Dataset::options(enum ngsOptionType optionType) const
                "  <Option name='CREATE_OVERVIEWS_TABLE' type='boolean' description='Create empty overviews table' default='NO'/>"
                "  <Option name='CREATE_OVERVIEWS' type='boolean' description='Create overviews table and fill it with overviews. The level should be set by ZOOM_LEVELS option' default='NO'/>"
                "  <Option name='ZOOM_LEVELS' type='string' description='Comma separated list of zoom level' default=''/>"
+               "  <Option name='COMPRESS_TILES' type='boolean' description='Deflate overview tiles' default='NO'/>"
+               "  <Option name='MAX_MEMORY_MB' type='integer' description='Memory limit for overview tiles. If exceeded, the tiles are flushed to the overviews table. 0 - unlimited' default='0'/>"
+               "  <Option name='BOTTOM_UP' type='boolean' description='Tile features only for the deepest zoom level and derive other levels from it' default='NO'/>"
                "</LoadOptionList>";
     }
 
@@ -781,55 +867,95 @@ int Dataset::paste(ObjectPtr child, bool move, const Options &options,
         }
         bool createOvr = options.boolOption("CREATE_OVERVIEWS", false) &&
                 !options.stringOption("ZOOM_LEVELS", "").empty();
-        bool toMulti = options.boolOption("FORCE_GEOMETRY_TO_MULTI", false);
         OGRFeatureDefn * const srcDefinition = srcFClass->definition();
-        std::vector<OGRwkbGeometryType> geometryTypes =
-                srcFClass->geometryTypes();
         OGRwkbGeometryType filterFeometryType =
                 FeatureClass::geometryTypeFromName(
                     options.stringOption("ACCEPT_GEOMETRY", "ANY"));
-        for(OGRwkbGeometryType geometryType : geometryTypes) {
-            if(filterFeometryType != geometryType &&
-                    filterFeometryType != wkbUnknown) {
-                continue;
-            }
-            CPLString createName = newName;
-            OGRwkbGeometryType newGeometryType = geometryType;
-            if(geometryTypes.size () > 1 && filterFeometryType == wkbUnknown) {
-                createName += "_";
-                createName += FeatureClass::geometryTypeName(geometryType,
+        OGRwkbGeometryType srcGeometryType = srcFClass->geometryType();
+        bool mixedTypes = OGR_GT_Flatten(srcGeometryType) == wkbUnknown ||
+                OGR_GT_Flatten(srcGeometryType) == wkbGeometryCollection;
+        if(!mixedTypes && filterFeometryType != srcGeometryType &&
+                filterFeometryType != wkbUnknown) {
+            return COD_SUCCESS;
+        }
+
+        // Create fields map. We expected equal count of fields
+        int fieldCount = srcDefinition->GetFieldCount();
+        FieldMapPtr fieldMap(static_cast<unsigned long>(fieldCount));
+        for(int i = 0; i < fieldCount; ++i) {
+            fieldMap[i] = i;
+        }
+
+        Progress progressMulti(progress);
+        if(createOvr) {
+            progressMulti.setTotalSteps(2);
+            progressMulti.setStep(0);
+        }
+
+        std::vector<std::unique_ptr<FeatureClass>> dstFClasses;
+        int result;
+        if(mixedTypes) {
+            // Feature classes are created on the first feature of the type
+            // while the source is read once
+            std::map<OGRwkbGeometryType, FeatureClass*> dstFClassesByType;
+            auto dstSelector = [&](OGRwkbGeometryType geometryType) -> FeatureClass* {
+                if(filterFeometryType != wkbUnknown) {
+                    geometryType = filterFeometryType;
+                }
+                else if(geometryType == wkbNone) {
+                    geometryType = wkbUnknown;
+                }
+
+                auto it = dstFClassesByType.find(geometryType);
+                if(it != dstFClassesByType.end()) {
+                    return it->second;
+                }
+
+                // The first feature class keeps the name, next ones get the
+                // geometry type suffix
+                CPLString createName = newName;
+                if(!dstFClassesByType.empty()) {
+                    createName += "_";
+                    createName += FeatureClass::geometryTypeName(geometryType,
                                         FeatureClass::GeometryReportType::SIMPLE);
-                if(toMulti && geometryType < wkbMultiPoint) {
-                    newGeometryType =
-                            static_cast<OGRwkbGeometryType>(geometryType + 3);
                 }
-            }
 
-            std::unique_ptr<FeatureClass> dstFClass(createFeatureClass(createName,
+                FeatureClass* dstFClass = createFeatureClass(createName,
+                    CAT_FC_ANY, srcDefinition, srcFClass->getSpatialReference(),
+                    geometryType, options);
+                if(nullptr == dstFClass) {
+                    return nullptr;
+                }
+                dstFClasses.emplace_back(dstFClass);
+                dstFClassesByType[geometryType] = dstFClass;
+                return dstFClass;
+            };
+
+            DatasetBatchOperationHolder holder(this);
+            result = FeatureClass::copyFeaturesByType(srcFClass, fieldMap,
+                                                      filterFeometryType,
+                                                      dstSelector,
+                                                      progressMulti, options);
+        }
+        else {
+            std::unique_ptr<FeatureClass> dstFClass(createFeatureClass(newName,
                 CAT_FC_ANY, srcDefinition, srcFClass->getSpatialReference(),
-                newGeometryType, options));
+                srcGeometryType, options));
             if(nullptr == dstFClass) {
                 return move ? COD_MOVE_FAILED : COD_COPY_FAILED;
             }
-            auto dstFields = dstFClass->fields();
-            // Create fields map. We expected equal count of fields
-            FieldMapPtr fieldMap(dstFields.size());
-            for(int i = 0; i < static_cast<int>(dstFields.size()); ++i) {
-                fieldMap[i] = i;
-            }
 
-            Progress progressMulti(progress);
-            if(createOvr) {
-                progressMulti.setTotalSteps(2);
-                progressMulti.setStep(0);
-            }
+            result = dstFClass->copyFeatures(srcFClass, fieldMap,
+                                             filterFeometryType,
+                                             progressMulti, options);
+            dstFClasses.push_back(std::move(dstFClass));
+        }
 
-            int result = dstFClass->copyFeatures(srcFClass, fieldMap,
-                                                 filterFeometryType,
-                                                 progressMulti, options);
-            if(result != COD_SUCCESS) {
-                return result;
-            }
+        if(result != COD_SUCCESS) {
+            return result;
+        }
+
+        for(const auto& dstFClass : dstFClasses) {
             fullNameStr = dstFClass->fullName();
 
             if(createOvr) {
@@ -921,7 +1047,7 @@ TablePtr Dataset::executeSQL(const char* statement, const char* dialect)
         return TablePtr();
     }
 
-    CPLMutexHolder holder(m_executeSQLMutex);
+    ReadWriteLockHolder holder(&m_executeSQLLock);
 
     OGRLayer* layer = m_DS->ExecuteSQL(statement, nullptr, dialect);
     if(nullptr == layer) {
@@ -934,6 +1060,21 @@ TablePtr Dataset::executeSQL(const char* statement, const char* dialect)
         return TablePtr(new FeatureClass(layer, this, CAT_QUERY_RESULT_FC));
 }
 
+void Dataset::executeStatement(const char* statement, const char* dialect)
+{
+    // Statements like SAVEPOINT or PRAGMA return no result set, which is not an
+    // error, so the last error message is kept untouched
+    if(nullptr == m_DS) {
+        return;
+    }
+
+    ReadWriteLockHolder holder(&m_executeSQLLock);
+    OGRLayer* layer = m_DS->ExecuteSQL(statement, nullptr, dialect);
+    if(nullptr != layer) {
+        m_DS->ReleaseResultSet(layer);
+    }
+}
+
 TablePtr Dataset::executeSQL(const char* statement,
                                     GeometryPtr spatialFilter,
                                     const char* dialect)
@@ -1212,7 +1353,7 @@ bool Dataset::deleteFeatures(const char* name)
     if(!ds)
         return false;
     CPLErrorReset();
-    CPLMutexHolder holder(m_executeSQLMutex);
+    ReadWriteLockHolder holder(&m_executeSQLLock);
     ds->ExecuteSQL(CPLSPrintf("DELETE from %s", name), nullptr, nullptr);
     return CPLGetLastErrorType() < CE_Failure;
 }
@@ -21,6 +21,7 @@
 #ifndef NGSDATASET_H
 #define NGSDATASET_H
 
+#include <map>
 #include <memory>
 
 #include "api_priv.h"
@@ -29,6 +30,7 @@
 
 #include "catalog/objectcontainer.h"
 #include "ngstore/codes.h"
+#include "util/rwlock.h"
 #include "util/stringutil.h"
 
 namespace ngs {
@@ -133,8 +135,12 @@ public:
     virtual void deleteProperties(const char* table);
     virtual void startBatchOperation() {}
     virtual void stopBatchOperation() {}
+    virtual void rollbackBatchOperation() {}
     virtual bool isBatchOperation() const { return false; }
-    virtual void lockExecuteSql(bool lock);
+    virtual void lockExecuteSql(bool lock, bool shared = false);
+    GUIntBig sqlLockContentionCount() const;
+    GDALDataset* acquireReadHandle();
+    void releaseReadHandle(GDALDataset* handle, bool reuse = true);
 
     // Object interface
 public:
@@ -199,11 +205,18 @@ protected:
     virtual void clearEditHistoryTable(const char* name);
     virtual const char* historyTableName(const char* name) const;
     virtual bool deleteFeatures(const char* name);
+    virtual bool canOpenReadHandles() const;
+    void closeReadHandles();
+    void executeStatement(const char* statement, const char* dialect = "");
 
 protected:
     GDALDataset* m_addsDS;
     OGRLayer* m_metadata;
-    CPLMutex* m_executeSQLMutex;
+    ReadWriteLock m_executeSQLLock;
+    std::vector<GDALDataset*> m_readHandles;
+    std::map<GDALDataset*, unsigned int> m_readHandleGenerations;
+    unsigned int m_readHandleGeneration;
+    CPLMutex* m_readHandlesMutex;
 };
 
 /**
@@ -222,28 +235,41 @@ public:
             m_dataset->stopBatchOperation();
     }
 
+    /**
+     * @brief rollback Discard changes made since the batch operation start
+     */
+    void rollback() {
+        if(nullptr != m_dataset)
+            m_dataset->rollbackBatchOperation();
+        m_dataset = nullptr;
+    }
+
 protected:
     Dataset* m_dataset;
 };
 
 /**
- * @brief The DatasetExecuteSQLLockHolder class lock sql excution in dataset
+ * @brief The DatasetExecuteSQLLockHolder class lock sql excution in dataset.
+ * Shared ownership is only for reading through own connections (read handles),
+ * any use of the main dataset connection needs exclusive ownership.
  */
 class DatasetExecuteSQLLockHolder
 {
 public:
-    DatasetExecuteSQLLockHolder(Dataset* dataset) : m_dataset(dataset) {
+    DatasetExecuteSQLLockHolder(Dataset* dataset, bool shared = false) :
+        m_dataset(dataset), m_shared(shared) {
         if(nullptr != m_dataset)
-            m_dataset->lockExecuteSql(true);
+            m_dataset->lockExecuteSql(true, m_shared);
     }
 
     ~DatasetExecuteSQLLockHolder() {
         if(nullptr != m_dataset)
-            m_dataset->lockExecuteSql(false);
+            m_dataset->lockExecuteSql(false, m_shared);
     }
 
 protected:
     Dataset* m_dataset;
+    bool m_shared;
 };
 
 }
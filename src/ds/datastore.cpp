@@ -49,6 +49,18 @@ namespace ngs {
 constexpr const char* STORE_EXT = "ngst"; // NextGIS Store
 constexpr int STORE_EXT_LEN = length(STORE_EXT);
 
+// Open options tuning the SQLite connection
+constexpr const char* JOURNAL_MODE_KEY = "JOURNAL_MODE";
+constexpr const char* SYNCHRONOUS_KEY = "SYNCHRONOUS";
+constexpr const char* CACHE_SIZE_KEY = "CACHE_SIZE";
+constexpr const char* MMAP_SIZE_KEY = "MMAP_SIZE";
+constexpr const char* DEFAULT_JOURNAL_MODE = "WAL";
+constexpr const char* DEFAULT_SYNCHRONOUS = "NORMAL";
+constexpr int DEFAULT_CACHE_SIZE = 16384; // Kb
+constexpr int DEFAULT_MMAP_SIZE = 0; // Mb
+
+constexpr const char* BATCH_SAVEPOINT = "ngs_batch";
+
 //------------------------------------------------------------------------------
 // DataStore
 //------------------------------------------------------------------------------
@@ -57,7 +69,9 @@ DataStore::DataStore(ObjectContainer * const parent,
                      const CPLString &name,
                      const CPLString &path) :
     Dataset(parent, CAT_CONTAINER_NGS, name, path),
-    m_disableJournalCounter(0)
+    m_batchLevel(0),
+    m_batchTransaction(false),
+    m_batchThread(0)
 {
     m_spatialReference = new OGRSpatialReference;
     m_spatialReference->importFromEPSG(DEFAULT_EPSG);
@@ -149,15 +163,29 @@ bool DataStore::open(unsigned int openFlags, const Options &options)
         return true;
     }
 
-    if(!Dataset::open(openFlags, options))
+    // Connection settings are not GeoPackage driver open options
+    Options openOptions(options);
+    openOptions.removeOption(JOURNAL_MODE_KEY);
+    openOptions.removeOption(SYNCHRONOUS_KEY);
+    openOptions.removeOption(CACHE_SIZE_KEY);
+    openOptions.removeOption(MMAP_SIZE_KEY);
+
+    if(!Dataset::open(openFlags, openOptions))
         return false;
 
     CPLErrorReset();
 
+    if(openFlags & GDAL_OF_UPDATE) {
+        setPragmas(options);
+    }
+
     int version = atoi(property(NGS_VERSION_KEY, "0"));
 
-    if(version < NGS_VERSION_NUM && !upgrade(version)) {
-        return errorMessage(_("Upgrade storage failed"));
+    if(version < NGS_VERSION_NUM && (openFlags & GDAL_OF_UPDATE)) {
+        if(!upgrade(version)) {
+            return errorMessage(_("Upgrade storage failed"));
+        }
+        setProperty(NGS_VERSION_KEY, CPLSPrintf("%d", NGS_VERSION_NUM));
     }
 
     return true;
@@ -176,7 +204,7 @@ FeatureClass* DataStore::createFeatureClass(const CPLString& name,
         return nullptr;
     }
 
-    CPLMutexHolder holder(m_executeSQLMutex);
+    ReadWriteLockHolder holder(&m_executeSQLLock);
 
     OGRLayer* layer = m_DS->CreateLayer(name, spatialRef, type,
                                         options.getOptions().get());
@@ -210,6 +238,8 @@ FeatureClass* DataStore::createFeatureClass(const CPLString& name,
         }
     }
 
+    createIndexes(layer);
+
     FeatureClass* out = new StoreFeatureClass(layer, this, name);
 
     if(options.boolOption("CREATE_OVERVIEWS", false) &&
@@ -236,7 +266,7 @@ Table* DataStore::createTable(const CPLString& name,
         return nullptr;
     }
 
-    CPLMutexHolder holder(m_executeSQLMutex);
+    ReadWriteLockHolder holder(&m_executeSQLLock);
 
     OGRLayer* layer = m_DS->CreateLayer(name, nullptr, wkbNone,
                                         options.getOptions().get());
@@ -270,6 +300,8 @@ Table* DataStore::createTable(const CPLString& name,
         }
     }
 
+    createIndexes(layer);
+
     Table* out = new StoreTable(layer, this, name);
 
     if(m_parent) {
@@ -283,13 +315,13 @@ Table* DataStore::createTable(const CPLString& name,
 
 bool DataStore::setProperty(const char* key, const char* value)
 {
-    CPLMutexHolder holder(m_executeSQLMutex);
+    ReadWriteLockHolder holder(&m_executeSQLLock);
     return m_DS->SetMetadataItem(key, value, NG_ADDITIONS_KEY) == OGRERR_NONE;
 }
 
 CPLString DataStore::property(const char* key, const char* defaultValue)
 {
-    CPLMutexHolder holder(m_executeSQLMutex);
+    ReadWriteLockHolder holder(&m_executeSQLLock);
     const char* out = m_DS->GetMetadataItem(key, NG_ADDITIONS_KEY);
     return nullptr == out ? defaultValue : out;
 }
@@ -402,33 +434,208 @@ bool DataStore::create(const enum ngsCatalogObjectType type,
     return true;
 }
 
-bool DataStore::upgrade(int /* oldVersion */)
+bool DataStore::upgrade(int oldVersion)
 {
-    // no structure changes for version 1
+    // Indexes for remote identifiers and edit history lookups
+    if(oldVersion < NGS_COMPUTE_VERSION(0, 5, 1)) {
+        for(int i = 0; i < m_DS->GetLayerCount(); ++i) {
+            createIndexes(m_DS->GetLayer(i));
+        }
+    }
     return true;
 }
 
-void DataStore::enableJournal(bool enable)
+void DataStore::createIndexes(OGRLayer* layer)
 {
-    if(enable) {        
-        m_disableJournalCounter--;
-        if(m_disableJournalCounter == 0) {
-            // executeSQL("PRAGMA synchronous = FULL", "SQLITE");
-            executeSQL("PRAGMA journal_mode = DELETE", "SQLITE");
-            //executeSQL("PRAGMA count_changes=ON", "SQLITE"); // This pragma is deprecated
-        }
+    if(nullptr == layer) {
+        return;
+    }
+
+    OGRFeatureDefn* definition = layer->GetLayerDefn();
+    std::vector<CPLString> columns;
+    if(definition->GetFieldIndex(OPERATION_FIELD) != -1 &&
+            definition->GetFieldIndex(FEATURE_ID_FIELD) != -1) {
+        // Edit history table
+        columns.push_back(CPLSPrintf("%s, %s", FEATURE_ID_FIELD,
+                                     ATTACH_FEATURE_ID_FIELD));
+        columns.push_back(OPERATION_FIELD);
     }
     else {
-        CPLAssert(m_disableJournalCounter < 255); // only 255 layers can simultanious load geodata
-        m_disableJournalCounter++;
-        if(m_disableJournalCounter == 1) {
-            // executeSQL("PRAGMA synchronous = OFF", "SQLITE");
-            executeSQL("PRAGMA journal_mode = OFF", "SQLITE");
-            //executeSQL("PRAGMA count_changes=OFF", "SQLITE"); // This pragma is deprecated
-            // executeSQL ("PRAGMA locking_mode=EXCLUSIVE", "SQLITE");
-            // executeSQL ("PRAGMA cache_size=15000", "SQLITE");
+        if(definition->GetFieldIndex(ATTACH_FILE_NAME_FIELD) != -1 &&
+                definition->GetFieldIndex(ATTACH_FEATURE_ID_FIELD) != -1) {
+            // Attachments table
+            columns.push_back(ATTACH_FEATURE_ID_FIELD);
+        }
+        if(definition->GetFieldIndex(REMOTE_ID_KEY) != -1) {
+            columns.push_back(REMOTE_ID_KEY);
+        }
+    }
+
+    ReadWriteLockHolder holder(&m_executeSQLLock);
+    const char* layerName = layer->GetName();
+    for(const CPLString& column : columns) {
+        CPLString indexName;
+        indexName.Printf("%s_%s_idx", layerName, column.c_str());
+        indexName.replaceAll(", ", "_");
+        m_DS->ExecuteSQL(CPLSPrintf("CREATE INDEX IF NOT EXISTS \"%s\" ON \"%s\" (%s)",
+                                    indexName.c_str(), layerName,
+                                    column.c_str()),
+                         nullptr, "SQLITE");
+    }
+}
+
+void DataStore::setPragmas(const Options& options)
+{
+    const char* journalModes[] = {"WAL", "DELETE", "TRUNCATE", "PERSIST",
+                                  "MEMORY", "OFF", nullptr};
+    CPLString journalMode = options.stringOption(JOURNAL_MODE_KEY,
+                                                 DEFAULT_JOURNAL_MODE);
+    if(CSLFindString(const_cast<char**>(journalModes), journalMode) == -1) {
+        warningMessage(_("Unsupported journal mode %s"), journalMode.c_str());
+        journalMode = DEFAULT_JOURNAL_MODE;
+    }
+
+    const char* synchronousModes[] = {"OFF", "NORMAL", "FULL", "EXTRA", nullptr};
+    CPLString synchronous = options.stringOption(SYNCHRONOUS_KEY,
+                                                 DEFAULT_SYNCHRONOUS);
+    if(CSLFindString(const_cast<char**>(synchronousModes), synchronous) == -1) {
+        warningMessage(_("Unsupported synchronous mode %s"), synchronous.c_str());
+        synchronous = DEFAULT_SYNCHRONOUS;
+    }
+
+    int cacheSize = options.intOption(CACHE_SIZE_KEY, DEFAULT_CACHE_SIZE);
+    int mmapSize = options.intOption(MMAP_SIZE_KEY, DEFAULT_MMAP_SIZE);
+
+    // In WAL mode readers don't block on writer and writer don't block on
+    // readers. Negative cache size is in Kb, not in pages.
+    executeStatement(CPLSPrintf("PRAGMA journal_mode = %s",
+                                journalMode.c_str()), "SQLITE");
+    executeStatement(CPLSPrintf("PRAGMA synchronous = %s",
+                                synchronous.c_str()), "SQLITE");
+    if(cacheSize > 0) {
+        executeStatement(CPLSPrintf("PRAGMA cache_size = -%d", cacheSize),
+                         "SQLITE");
+    }
+    if(mmapSize > 0) {
+        executeStatement(CPLSPrintf("PRAGMA mmap_size = " CPL_FRMT_GIB,
+                                    static_cast<GIntBig>(mmapSize) * 1024 * 1024),
+                         "SQLITE");
+    }
+}
+
+void DataStore::startBatchOperation()
+{
+    ReadWriteLockHolder holder(&m_executeSQLLock);
+    CPLAssert(m_batchLevel < 255); // only 255 layers can simultanious load geodata
+    // Savepoints nest as a stack, so only the thread started the batch may
+    // nest it
+    CPLAssert(m_batchLevel == 0 || m_batchThread == CPLGetPID());
+    m_batchLevel++;
+    if(m_batchLevel == 1) {
+        m_batchThread = CPLGetPID();
+        m_batchTransaction = nullptr != m_DS &&
+                m_DS->StartTransaction() == OGRERR_NONE;
+        if(!m_batchTransaction) {
+            warningMessage(_("Batch operation started without transaction"));
         }
     }
+    else if(m_batchTransaction) {
+        // Rollback to savepoint must not lose edit history logged before it
+        for(const ObjectPtr& child : m_children) {
+            Table* const table = ngsDynamicCast(Table, child);
+            if(nullptr != table) {
+                table->flushEditHistory();
+            }
+        }
+        executeStatement(CPLSPrintf("SAVEPOINT %s_%d", BATCH_SAVEPOINT,
+                                    m_batchLevel), "SQLITE");
+    }
+}
+
+void DataStore::stopBatchOperation()
+{
+    ReadWriteLockHolder holder(&m_executeSQLLock);
+    if(m_batchLevel == 0) {
+        return;
+    }
+
+    if(m_batchLevel == 1) {
+        // Write edit history and update overviews with features edited during
+        // batch operation
+        for(const ObjectPtr& child : m_children) {
+            Table* const table = ngsDynamicCast(Table, child);
+            if(nullptr != table) {
+                table->flushEditHistory();
+            }
+            FeatureClass* const featureClass = ngsDynamicCast(FeatureClass,
+                                                              child);
+            if(nullptr != featureClass) {
+                featureClass->flushOverviews();
+            }
+        }
+
+        if(m_batchTransaction && m_DS->CommitTransaction() != OGRERR_NONE) {
+            errorMessage(CPLGetLastErrorMsg());
+        }
+        m_batchTransaction = false;
+    }
+    else if(m_batchTransaction) {
+        executeStatement(CPLSPrintf("RELEASE SAVEPOINT %s_%d",
+                                    BATCH_SAVEPOINT, m_batchLevel), "SQLITE");
+    }
+    m_batchLevel--;
+}
+
+void DataStore::rollbackBatchOperation()
+{
+    ReadWriteLockHolder holder(&m_executeSQLLock);
+    if(m_batchLevel == 0) {
+        return;
+    }
+    // Savepoint of the current level belongs to the thread started the batch
+    CPLAssert(m_batchThread == CPLGetPID());
+
+    if(m_batchLevel == 1) {
+        if(m_batchTransaction) {
+            m_DS->RollbackTransaction();
+        }
+        m_batchTransaction = false;
+        // Rebuild dirty tiles to match the restored features and reload
+        // restored edit history on next edit
+        for(const ObjectPtr& child : m_children) {
+            Table* const table = ngsDynamicCast(Table, child);
+            if(nullptr != table) {
+                table->discardEditHistory();
+            }
+            FeatureClass* const featureClass = ngsDynamicCast(FeatureClass,
+                                                              child);
+            if(nullptr != featureClass) {
+                // Merged extent may include rolled back features
+                featureClass->invalidateExtent();
+                featureClass->flushOverviews();
+            }
+        }
+    }
+    else if(m_batchTransaction) {
+        for(const ObjectPtr& child : m_children) {
+            Table* const table = ngsDynamicCast(Table, child);
+            if(nullptr != table) {
+                table->discardEditHistory();
+            }
+        }
+        executeStatement(CPLSPrintf("ROLLBACK TO SAVEPOINT %s_%d",
+                                    BATCH_SAVEPOINT, m_batchLevel), "SQLITE");
+        executeStatement(CPLSPrintf("RELEASE SAVEPOINT %s_%d",
+                                    BATCH_SAVEPOINT, m_batchLevel), "SQLITE");
+        for(const ObjectPtr& child : m_children) {
+            FeatureClass* const featureClass = ngsDynamicCast(FeatureClass,
+                                                              child);
+            if(nullptr != featureClass) {
+                featureClass->invalidateExtent();
+            }
+        }
+    }
+    m_batchLevel--;
 }
 
 OGRLayer* DataStore::createAttachmentsTable(const char* name)
@@ -472,6 +679,8 @@ OGRLayer* DataStore::createAttachmentsTable(const char* name)
         return nullptr;
     }
 
+    createIndexes(attLayer);
+
     return attLayer;
 }
 
@@ -510,6 +719,8 @@ OGRLayer*DataStore::createEditHistoryTable(const char* name)
         return nullptr;
     }
 
+    createIndexes(logLayer);
+
     return logLayer;
 }
 
@@ -50,10 +50,11 @@ public:
 public:
     virtual bool open(unsigned int openFlags,
                       const Options &options = Options()) override;
-    virtual void startBatchOperation() override { enableJournal(false); }
-    virtual void stopBatchOperation() override { enableJournal(true); }
+    virtual void startBatchOperation() override;
+    virtual void stopBatchOperation() override;
+    virtual void rollbackBatchOperation() override;
     virtual bool isBatchOperation() const override {
-        return m_disableJournalCounter > 0;
+        return m_batchLevel > 0;
     }
 
     virtual FeatureClass* createFeatureClass(const CPLString& name,
@@ -91,11 +92,17 @@ protected:
     virtual void fillFeatureClasses() override;
 
 protected:
-    void enableJournal(bool enable);
+    void setPragmas(const Options& options);
+    void createIndexes(OGRLayer* layer);
     bool upgrade(int oldVersion);
 
 protected:
-    unsigned char m_disableJournalCounter;
+    // Batch operation is shared by the dataset. Nested levels are savepoints
+    // of one transaction, so they must be started, stopped and rolled back by
+    // the thread started the batch. Other threads may only edit inside it.
+    unsigned char m_batchLevel;
+    bool m_batchTransaction;
+    GIntBig m_batchThread;
 
 };
 
@@ -21,6 +21,8 @@
 #include "featureclass.h"
 
 #include <algorithm>
+#include <iterator>
+#include <memory>
 
 #include "api_priv.h"
 #include "coordinatetransformation.h"
@@ -42,6 +44,17 @@ namespace ngs {
 constexpr const char* ZOOM_LEVELS_OPTION = "ZOOM_LEVELS";
 constexpr unsigned short TILE_SIZE = 256; //240; //512;// 160; // Only use for overviews now in pixelSize
 constexpr double WORLD_WIDTH = DEFAULT_BOUNDS_X2.width();
+constexpr const char* MAX_MEMORY_MB_OPTION = "MAX_MEMORY_MB";
+constexpr const char* COMPRESS_TILES_OPTION = "COMPRESS_TILES";
+constexpr const char* COMPRESS_TILES_KEY = "compress_tiles";
+constexpr size_t BYTES_IN_MB = 1024 * 1024;
+constexpr size_t OVR_FEATURE_BATCH_SIZE = 5000;
+constexpr const char* BOTTOM_UP_OPTION = "BOTTOM_UP";
+constexpr const char* SPATIAL_INDEX_OPTION = "NGS_SPATIAL_INDEX";
+constexpr const char* SPATIAL_INDEX_EXT = "ngsidx";
+constexpr size_t COPY_REORDER_WINDOW = 4 * COPY_QUEUE_SIZE;
+
+static std::atomic<GUIntBig> genTilesGenerations(0);
 
 //------------------------------------------------------------------------------
 // TilingData
@@ -49,59 +62,304 @@ constexpr double WORLD_WIDTH = DEFAULT_BOUNDS_X2.width();
 
 class TilingData : public ThreadData {
 public:
-    TilingData(FeatureClass* featureClass, FeaturePtr feature, bool own) :
-        ThreadData(own), m_feature(feature), m_featureClass(featureClass) {
+    TilingData(FeatureClass* featureClass, FeaturePtr feature,
+               bool deepestZoomOnly, bool own) :
+        ThreadData(own), m_feature(feature), m_featureClass(featureClass),
+        m_deepestZoomOnly(deepestZoomOnly) {
 
     }
     FeaturePtr m_feature;
     FeatureClass* m_featureClass;
+    bool m_deepestZoomOnly;
 };
 
 //------------------------------------------------------------------------------
-// FeatureClass
+// OverviewTileData
 //------------------------------------------------------------------------------
 
-FeatureClass::FeatureClass(OGRLayer* layer, ObjectContainer * const parent,
-                           const enum ngsCatalogObjectType type,
-                           const CPLString &name) :
-    Table(layer, parent, type, name),
-    m_ovrTable(nullptr),
-    m_genTileMutex(CPLCreateMutex()),
-    m_creatingOvr(false)
+class OverviewTileData : public ThreadData {
+public:
+    OverviewTileData(FeatureClass* featureClass, const Tile& tile,
+                     unsigned char zoom, double step, bool isLine, bool own) :
+        ThreadData(own), m_featureClass(featureClass), m_tile(tile),
+        m_zoom(zoom), m_step(step), m_isLine(isLine) {
+
+    }
+    FeatureClass* m_featureClass;
+    Tile m_tile;
+    VectorTile m_vtile;
+    unsigned char m_zoom;
+    double m_step;
+    bool m_isLine;
+};
+
+//------------------------------------------------------------------------------
+// CopyFeatures
+//------------------------------------------------------------------------------
+
+/**
+ * @brief The CopyItem struct Source feature with the geometry prepared for the
+ * destination feature class.
+ */
+typedef struct _copyItem {
+    GIntBig index;
+    FeaturePtr feature;
+    GeometryUPtr geometry;
+    OGRwkbGeometryType type;
+    bool skip;
+} CopyItem;
+
+typedef BoundedQueue<CopyItem> CopyQueue;
+
+class CopyTransformData {
+public:
+    FeatureReader::Queue* m_input;
+    CopyQueue* m_output;
+    std::atomic<int>* m_activeWorkers;
+    std::unique_ptr<CoordinateTransformation> m_transformation;
+    CancelToken m_token;
+    OGRwkbGeometryType m_dstGeomType;
+    OGRwkbGeometryType m_filterGeomType;
+    bool m_skipEmpty;
+    bool m_skipInvalid;
+    bool m_toMulti;
+    bool m_byType;
+};
+
+static void prepareCopyItem(CopyItem& item, CopyTransformData* data)
 {
-    CPLReleaseMutex(m_genTileMutex);
+    item.skip = false;
+    item.type = wkbNone;
+    OGRGeometry* geom = item.feature->GetGeometryRef();
+    if(nullptr == geom) {
+        item.skip = data->m_skipEmpty;
+        return;
+    }
 
-    if(nullptr != m_layer) {
-        m_spatialReference = m_layer->GetSpatialRef();
+    if(data->m_skipEmpty && geom->IsEmpty()) {
+        item.skip = true;
+        return;
+    }
+    if(data->m_skipInvalid && !geom->IsValid()) {
+        item.skip = true;
+        return;
+    }
 
-        OGRFeatureDefn* defn = m_layer->GetLayerDefn();
-        for(int i = 0; i < defn->GetFieldCount(); ++i) {
-            OGRFieldDefn* fld = defn->GetFieldDefn(i);
-            m_ignoreFields.push_back(fld->GetNameRef());
+    OGRwkbGeometryType geomType = geom->getGeometryType();
+    OGRwkbGeometryType multiGeomType = geomType;
+    if (OGR_GT_Flatten(geomType) < wkbPolygon && data->m_toMulti) {
+        multiGeomType = static_cast<OGRwkbGeometryType>(geomType + 3);
+    }
+    if (data->m_filterGeomType != wkbUnknown &&
+            data->m_filterGeomType != multiGeomType) {
+        item.skip = true;
+        return;
+    }
+
+    OGRwkbGeometryType dstGeomType = data->m_dstGeomType;
+    if(data->m_byType) {
+        // Only point, line and polygon features are separated by type. Other
+        // ones (collections, curves and surfaces) go to the feature class of
+        // any geometry type as is.
+        dstGeomType = OGR_GT_Flatten(geomType);
+        if(dstGeomType < wkbPoint || dstGeomType > wkbMultiPolygon) {
+            dstGeomType = wkbUnknown;
         }
-        m_ignoreFields.push_back("OGR_STYLE");
+        else if(data->m_toMulti && dstGeomType < wkbMultiPoint) {
+            dstGeomType = static_cast<OGRwkbGeometryType>(dstGeomType + 3);
+        }
+    }
 
-        fillZoomLevels();
+    OGRGeometry* newGeom = geom->clone();
+    if (dstGeomType != geomType && dstGeomType != wkbUnknown) {
+        newGeom = OGRGeometryFactory::forceTo(newGeom, dstGeomType);
+    }
 
-        OGREnvelope env;
-        if(m_layer->GetExtent(&env, 0) == OGRERR_NONE ||
-            m_layer->GetExtent(&env, 1) == OGRERR_NONE) {
-            m_extent = env;
+    data->m_transformation->transform(newGeom);
+    item.geometry.reset(newGeom);
+    item.type = dstGeomType;
+}
+
+static void copyTransformThread(void* threadData)
+{
+    CopyTransformData* data = static_cast<CopyTransformData*>(threadData);
+    FeatureReader::Item readItem;
+    while(!data->m_token.isCancelled() && data->m_input->pop(readItem)) {
+        CopyItem item;
+        item.index = readItem.first;
+        item.feature = readItem.second;
+        prepareCopyItem(item, data);
+        if(!data->m_output->push(std::move(item))) {
+            break;
         }
-        else {
-            CPLDebug("ngstore", "GetExent failed");
+    }
+
+    // Last worker finishes the output
+    if(--(*data->m_activeWorkers) == 0) {
+        data->m_output->close();
+    }
+}
+
+static int copyFeaturesPipeline(const FeatureClassPtr& srcFClass,
+                                const FieldMapPtr& fieldMap,
+                                OGRwkbGeometryType filterGeomType,
+                                OGRwkbGeometryType dstGeomType, bool byType,
+                                OGRSpatialReference* dstSRS,
+                                const FeatureClassSelector& dstSelector,
+                                const Progress& progress,
+                                const Options& options)
+{
+    bool skipEmpty = options.boolOption("SKIP_EMPTY_GEOMETRY", false);
+    bool skipInvalid = options.boolOption("SKIP_INVALID_GEOMETRY", false);
+    bool toMulti = options.boolOption("FORCE_GEOMETRY_TO_MULTI", false);
+
+    OGRSpatialReference* srcSRS = srcFClass->getSpatialReference();
+    GIntBig featureCount = srcFClass->featureCount();
+    double counter = 0;
+
+    // Source features are read in own thread, validated, converted and
+    // reprojected by the workers and inserted here in the read order
+    // Features are reordered on insert, so the reader is held within the
+    // window from the next feature to insert. It bounds the pending items.
+    FeatureReader reader(srcFClass, COPY_QUEUE_SIZE, COPY_REORDER_WINDOW);
+    CopyQueue output(COPY_QUEUE_SIZE);
+    CancelToken token;
+    unsigned char workerCount = getNumberThreads();
+    std::atomic<int> activeWorkers(workerCount);
+    std::vector<CopyTransformData> workerData(workerCount);
+    std::vector<CPLJoinableThread*> workers;
+    reader.start();
+    for(auto& data : workerData) {
+        data.m_input = &reader.queue();
+        data.m_output = &output;
+        data.m_activeWorkers = &activeWorkers;
+        // Coordinate transformation is not thread safe
+        data.m_transformation.reset(new CoordinateTransformation(srcSRS, dstSRS));
+        data.m_token = token;
+        data.m_dstGeomType = dstGeomType;
+        data.m_filterGeomType = filterGeomType;
+        data.m_skipEmpty = skipEmpty;
+        data.m_skipInvalid = skipInvalid;
+        data.m_toMulti = toMulti;
+        data.m_byType = byType;
+
+        CPLJoinableThread* worker = CPLCreateJoinableThread(copyTransformThread,
+                                                            &data);
+        if(nullptr != worker) {
+            workers.push_back(worker);
         }
+        else if(--activeWorkers == 0) {
+            output.close();
+        }
+    }
+
+    auto stopCopy = [&]() {
+        token.cancel();
+        output.close();
+        reader.stop();
+        for(CPLJoinableThread* worker : workers) {
+            CPLJoinThread(worker);
+        }
+        workers.clear();
+    };
+
+    if(workers.empty()) {
+        stopCopy();
+        return errorMessage(COD_COPY_FAILED, _("Failed to start copy threads"));
+    }
 
-        m_fastSpatialFilter = m_layer->TestCapability(OLCFastSpatialFilter) == 1;
+    std::map<GIntBig, CopyItem> pending;
+    GIntBig nextIndex = 0;
+    CopyItem copyItem;
+    while(output.pop(copyItem)) {
+        GIntBig index = copyItem.index;
+        pending.insert(std::make_pair(index, std::move(copyItem)));
+
+        auto it = pending.begin();
+        while(it != pending.end() && it->first == nextIndex) {
+            CopyItem& item = it->second;
+            double complete = counter / featureCount;
+            if(!progress.onProgress(COD_IN_PROCESS, complete,
+                                    _("Copy in process ..."))) {
+                stopCopy();
+                return COD_CANCELED;
+            }
+            nextIndex++;
+
+            if(!item.skip) {
+                FeatureClass* dstFClass = dstSelector(item.type);
+                if(nullptr == dstFClass) {
+                    stopCopy();
+                    return COD_COPY_FAILED;
+                }
+
+                FeaturePtr dstFeature = dstFClass->createFeature();
+                if(item.geometry) {
+                    dstFeature->SetGeometryDirectly(item.geometry.release());
+                }
+                dstFeature->SetFieldsFrom(item.feature, fieldMap.get());
+
+                if(!dstFClass->insertFeature(dstFeature)) {
+                    if(!progress.onProgress(COD_WARNING, complete,
+                                       _("Create feature failed. Source feature FID:" CPL_FRMT_GIB),
+                                       item.feature->GetFID ())) {
+                        stopCopy();
+                        return COD_CANCELED;
+                    }
+                }
+                counter++;
+            }
+            it = pending.erase(it);
+        }
+        reader.setConsumed(nextIndex);
     }
+    stopCopy();
 
-    getTilesTable();
+    progress.onProgress(COD_FINISHED, 1.0, _("Done. Copied %d features"),
+                       int(counter));
+
+    return COD_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+// FeatureClass
+//------------------------------------------------------------------------------
+
+FeatureClass::FeatureClass(OGRLayer* layer, ObjectContainer * const parent,
+                           const enum ngsCatalogObjectType type,
+                           const CPLString &name) :
+    Table(layer, parent, type, name),
+    m_ovrTable(nullptr),
+    m_fastSpatialFilter(false),
+    m_spatialIndexReset(false),
+    m_creatingOvr(false),
+    m_compressTiles(false),
+    m_dirtyTilesMutex(CPLCreateMutex()),
+    m_propertiesLoaded(false),
+    m_extentLoaded(false),
+    m_extentChanged(false),
+    m_propertiesMutex(CPLCreateMutex()),
+    m_genTilesMutex(CPLCreateMutex()),
+    m_genTilesGeneration(++genTilesGenerations),
+    m_genTilesPeakMemory(0)
+{
+    CPLReleaseMutex(m_dirtyTilesMutex);
+    CPLReleaseMutex(m_propertiesMutex);
+    CPLReleaseMutex(m_genTilesMutex);
+
+    // Other properties are loaded on first use, so listing of dataset
+    // children does not read layer definitions, extents and metadata
+    if(nullptr != m_layer) {
+        m_spatialReference = m_layer->GetSpatialRef();
+    }
 }
 
 FeatureClass::~FeatureClass()
 {
-    CPLDebug("ngstore", "CPLDestroyMutex(m_genTileMutex)");
-    CPLDestroyMutex(m_genTileMutex);
+    CPLDebug("ngstore", "CPLDestroyMutex(m_genTilesMutex)");
+    CPLDestroyMutex(m_genTilesMutex);
+    CPLDestroyMutex(m_dirtyTilesMutex);
+    CPLDestroyMutex(m_propertiesMutex);
 }
 
 OGRwkbGeometryType FeatureClass::geometryType() const
@@ -146,78 +404,34 @@ int FeatureClass::copyFeatures(const FeatureClassPtr srcFClass,
                        _("Start copy features from '%s' to '%s'"),
                        srcFClass->name().c_str(), m_name.c_str());
 
-    bool skipEmpty = options.boolOption("SKIP_EMPTY_GEOMETRY", false);
-    bool skipInvalid = options.boolOption("SKIP_INVALID_GEOMETRY", false);
-    bool toMulti = options.boolOption("FORCE_GEOMETRY_TO_MULTI", false);
-
     DatasetBatchOperationHolder holder(dynamic_cast<Dataset*>(m_parent));
+    return copyFeaturesPipeline(srcFClass, fieldMap, filterGeomType,
+                                geometryType(), false, getSpatialReference(),
+                                [this](OGRwkbGeometryType) { return this; },
+                                progress, options);
+}
 
-    OGRSpatialReference* srcSRS = srcFClass->getSpatialReference();
-    OGRSpatialReference* dstSRS = getSpatialReference();
-    CoordinateTransformation CT(srcSRS, dstSRS);
-    GIntBig featureCount = srcFClass->featureCount();
-    OGRwkbGeometryType dstGeomType = geometryType();
-    double counter = 0;
-    srcFClass->reset();
-    FeaturePtr feature;
-    while((feature = srcFClass->nextFeature())) {
-        double complete = counter / featureCount;
-        if(!progress.onProgress(COD_IN_PROCESS, complete,
-                                _("Copy in process ..."))) {
-            return COD_CANCELED;
-        }
-
-        OGRGeometry* geom = feature->GetGeometryRef();
-        OGRGeometry* newGeom = nullptr;
-        if(nullptr == geom) {
-            if(skipEmpty) {
-                continue;
-            }
-        }
-        else {
-            if(skipEmpty && geom->IsEmpty()) {
-                continue;
-            }
-            if(skipInvalid && !geom->IsValid()) {
-                continue;
-            }
-
-            OGRwkbGeometryType geomType = geom->getGeometryType();
-            OGRwkbGeometryType multiGeomType = geomType;
-            if (OGR_GT_Flatten(geomType) < wkbPolygon && toMulti) {
-                multiGeomType = static_cast<OGRwkbGeometryType>(geomType + 3);
-            }
-            if (filterGeomType != wkbUnknown && filterGeomType != multiGeomType) {
-                continue;
-            }
-
-            newGeom = geom->clone();
-            if (dstGeomType != geomType) {
-                newGeom = OGRGeometryFactory::forceTo(newGeom, dstGeomType);
-            }
-
-            CT.transform(newGeom);
-        }
-
-        FeaturePtr dstFeature = createFeature();
-        if(nullptr != newGeom) {
-            dstFeature->SetGeometryDirectly(newGeom);
-        }
-        dstFeature->SetFieldsFrom(feature, fieldMap.get());
-
-        if(!insertFeature(dstFeature)) {
-            if(!progress.onProgress(COD_WARNING, complete,
-                               _("Create feature failed. Source feature FID:" CPL_FRMT_GIB),
-                               feature->GetFID ())) {
-                return COD_CANCELED;
-            }
-        }
-        counter++;
+int FeatureClass::copyFeaturesByType(const FeatureClassPtr srcFClass,
+                                     const FieldMapPtr fieldMap,
+                                     OGRwkbGeometryType filterGeomType,
+                                     const FeatureClassSelector& dstSelector,
+                                     const Progress& progress,
+                                     const Options& options)
+{
+    if(!srcFClass) {
+        return errorMessage(COD_COPY_FAILED, _("Source feature class is invalid"));
     }
-    progress.onProgress(COD_FINISHED, 1.0, _("Done. Copied %d features"),
-                       int(counter));
 
-    return COD_SUCCESS;
+    progress.onProgress(COD_IN_PROCESS, 0.0,
+                       _("Start copy features from '%s'"),
+                       srcFClass->name().c_str());
+
+    // Without filter features are separated by own geometry type, else all
+    // of them converted to the filter type
+    return copyFeaturesPipeline(srcFClass, fieldMap, filterGeomType,
+                                filterGeomType, filterGeomType == wkbUnknown,
+                                srcFClass->getSpatialReference(), dstSelector,
+                                progress, options);
 }
 
 bool FeatureClass::hasOverviews() const
@@ -288,10 +502,48 @@ FeaturePtr FeatureClass::getTileFeature(const Tile& tile)
     return out;
 }
 
+FeaturePtr FeatureClass::readTileFeature(const Tile& tile)
+{
+    if(!getTilesTable()) {
+        return FeaturePtr();
+    }
+
+    Dataset* dataset = dynamic_cast<Dataset*>(m_parent);
+    if(nullptr == dataset) {
+        return FeaturePtr();
+    }
+
+    GDALDataset* readHandle = nullptr;
+    FeaturePtr out;
+    {
+        DatasetExecuteSQLLockHolder holder(dataset, true);
+        readHandle = dataset->acquireReadHandle();
+        OGRLayer* ovrTable = nullptr;
+        if(nullptr != readHandle) {
+            ovrTable = readHandle->GetLayerByName(m_ovrTable->GetName());
+        }
+
+        if(nullptr != ovrTable) {
+            ovrTable->SetAttributeFilter(CPLSPrintf("%s = %d AND %s = %d AND %s = %d",
+                                                    OVR_X_KEY, tile.x,
+                                                    OVR_Y_KEY, tile.y,
+                                                    OVR_ZOOM_KEY, tile.z));
+            out = ovrTable->GetNextFeature();
+            ovrTable->SetAttributeFilter(nullptr);
+            dataset->releaseReadHandle(readHandle);
+            return out;
+        }
+    }
+
+    // Handle opened before the overviews table was created
+    dataset->releaseReadHandle(readHandle, false);
+    return getTileFeature(tile);
+}
+
 VectorTile FeatureClass::getTileInternal(const Tile& tile)
 {
     VectorTile vtile;
-    FeaturePtr ovrTile = getTileFeature(tile);
+    FeaturePtr ovrTile = readTileFeature(tile);
     if(ovrTile) {
         int size = 0;
         GByte* data = ovrTile->GetFieldAsBinary(ovrTile->GetFieldIndex(OVR_TILE_KEY),
@@ -357,25 +609,248 @@ bool FeatureClass::tilingDataJobThreadFunc(ThreadData* threadData)
             auto vItems = data->m_featureClass->tileGeometry(fid, geosGeom, ext);
             data->m_featureClass->addOverviewItem(tileItem.tile, vItems);
         }
+
+        // Other zoom levels will be derived from this one.
+        if(data->m_deepestZoomOnly) {
+            break;
+        }
     }
 
     return true;
 }
 
-bool FeatureClass::createOverviews(const Progress &progress, const Options &options)
+bool FeatureClass::overviewTileJobThreadFunc(ThreadData* threadData)
 {
-    CPLDebug("ngstore", "start create overviews");
+    OverviewTileData* data = static_cast<OverviewTileData*>(threadData);
+    int shift = data->m_tile.z - data->m_zoom;
+    Tile parent = { data->m_tile.x >> shift, data->m_tile.y >> shift,
+                    data->m_zoom, data->m_tile.crossExtent };
+
+    VectorTileItemArray items = data->m_vtile.items();
+    for(auto& item : items) {
+        item.snapToGrid(data->m_step, data->m_isLine);
+    }
+
+    // Collapsed items are skipped and items of neighbour child tiles are
+    // deduplicated here.
+    data->m_featureClass->addOverviewItem(parent, items);
+    return true;
+}
+
+void FeatureClass::deriveOverviewZoom(unsigned char zoom,
+                                      unsigned char childZoom, double step)
+{
+    ThreadPool threadPool;
+    threadPool.init(getNumberThreads(), overviewTileJobThreadFunc);
+
+    // Point items keep a single point after snapping, line items don't
+    OGRwkbGeometryType type = OGR_GT_Flatten(geometryType());
+    bool isLine = type == wkbLineString || type == wkbMultiLineString;
+
+    DatasetExecuteSQLLockHolder holder(dynamic_cast<Dataset*>(m_parent));
+    m_ovrTable->SetAttributeFilter(CPLSPrintf("%s = %d", OVR_ZOOM_KEY,
+                                              childZoom));
+    m_ovrTable->ResetReading();
+    FeaturePtr ovrTile;
+    while((ovrTile = m_ovrTable->GetNextFeature())) {
+        Tile tile = { ovrTile->GetFieldAsInteger(OVR_X_KEY),
+                      ovrTile->GetFieldAsInteger(OVR_Y_KEY), childZoom, 0 };
+        OverviewTileData* data = new OverviewTileData(this, tile, zoom, step,
+                                                      isLine, true);
+        int size = 0;
+        GByte* tileData = ovrTile->GetFieldAsBinary(
+                    ovrTile->GetFieldIndex(OVR_TILE_KEY), &size);
+        Buffer buff(tileData, size, false);
+        data->m_vtile.load(buff);
+        threadPool.addThreadData(data);
+
+        if(threadPool.dataCount() >= OVR_FEATURE_BATCH_SIZE) {
+            threadPool.waitComplete(Progress());
+        }
+    }
+    m_ovrTable->SetAttributeFilter(nullptr);
+
+    threadPool.waitComplete(Progress());
+    threadPool.clearThreadData();
+}
+
+static Envelope tileEnvelope(const Tile& tile)
+{
+    double tileSize = DEFAULT_BOUNDS.width() / (1 << tile.z);
+    double minX = DEFAULT_BOUNDS.minX() + tile.x * tileSize;
+    double minY = DEFAULT_BOUNDS.minY() + tile.y * tileSize;
+    return Envelope(minX, minY, minX + tileSize, minY + tileSize);
+}
+
+FeatureClass::GenTiles* FeatureClass::threadGenTiles()
+{
+    // Generation is unique for each feature class and each clear of generated
+    // tiles, so the cache can't point to tiles of other or deleted object
+    static thread_local struct {
+        const FeatureClass* owner;
+        GUIntBig generation;
+        GenTiles* tiles;
+    } cache = { nullptr, 0, nullptr };
+
+    GUIntBig generation = m_genTilesGeneration;
+    if(cache.owner == this && cache.generation == generation) {
+        return cache.tiles;
+    }
+
+    CPLMutexHolder holder(m_genTilesMutex, 150.0);
+    std::unique_ptr<GenTiles>& tiles = m_genTiles[CPLGetPID()];
+    if(!tiles) {
+        tiles.reset(new GenTiles);
+        tiles->memory = 0;
+    }
+    cache.owner = this;
+    cache.generation = generation;
+    cache.tiles = tiles.get();
+    return cache.tiles;
+}
+
+void FeatureClass::addOverviewItem(const Tile& tile,
+                                   const VectorTileItemArray& items)
+{
+    size_t itemsSize = 0;
+    for(const auto& item : items) {
+        itemsSize += item.memorySize();
+    }
+
+    GenTiles* genTiles = threadGenTiles();
+    genTiles->tiles[tile].add(items, true);
+    genTiles->memory += itemsSize;
+}
+
+void FeatureClass::clearGenTiles()
+{
+    CPLMutexHolder holder(m_genTilesMutex, 150.0);
     m_genTiles.clear();
+    m_genTilesGeneration = ++genTilesGenerations;
+}
+
+size_t FeatureClass::genTilesMemory() const
+{
+    CPLMutexHolder holder(m_genTilesMutex, 150.0);
+    size_t out = 0;
+    for(const auto& genTiles : m_genTiles) {
+        out += genTiles.second->memory;
+    }
+    return out;
+}
+
+bool FeatureClass::flushOverviewTiles(std::set<Tile>& flushedTiles,
+                                      const Progress& progress)
+{
+    if(!getTilesTable()) {
+        return false;
+    }
+
+    // Generated tiles only grow between flushes, so the peak is here.
+    size_t memory = genTilesMemory();
+    if(memory > m_genTilesPeakMemory) {
+        m_genTilesPeakMemory = memory;
+    }
+
+    // Merge tiles generated by the tiling threads
+    std::map<Tile, VectorTile> tiles;
+    {
+        CPLMutexHolder holder(m_genTilesMutex, 150.0);
+        for(auto& genTiles : m_genTiles) {
+            for(auto& item : genTiles.second->tiles) {
+                auto it = tiles.find(item.first);
+                if(it == tiles.end()) {
+                    tiles.insert(std::make_pair(item.first,
+                                                std::move(item.second)));
+                }
+                else {
+                    it->second.add(item.second.items(), true);
+                }
+            }
+        }
+    }
+    clearGenTiles();
+    size_t tileCount = tiles.size();
+
+    Dataset* parentDS = dynamic_cast<Dataset*>(m_parent);
+    DatasetExecuteSQLLockHolder holder(parentDS);
+    DatasetBatchOperationHolder batchHolder(parentDS);
+
+    CPLDebug("ngstore", "Flush %ld tiles (%ld bytes) to overviews table",
+             static_cast<long>(tileCount), static_cast<long>(memory));
+
+    bool result = true;
+    double counter = 0.0;
+    for(auto& item : tiles) {
+        if(!item.second.isValid() || item.second.empty()) {
+            continue;
+        }
+
+        // Tile was saved by previous flush. Merge partial tiles.
+        FeaturePtr tile;
+        if(flushedTiles.find(item.first) != flushedTiles.end()) {
+            tile = getTileFeature(item.first);
+        }
+
+        bool create = true;
+        if(tile) {
+            int size = 0;
+            GByte* data = tile->GetFieldAsBinary(tile->GetFieldIndex(
+                                                     OVR_TILE_KEY), &size);
+            Buffer buff(data, size, false);
+            VectorTile vtile;
+            vtile.load(buff);
+            vtile.add(item.second.items(), true);
+            item.second = vtile;
+            create = false;
+        }
+        else {
+            tile = OGRFeature::CreateFeature(m_ovrTable->GetLayerDefn());
+
+            tile->SetField(OVR_ZOOM_KEY, item.first.z);
+            tile->SetField(OVR_X_KEY, item.first.x);
+            tile->SetField(OVR_Y_KEY, item.first.y);
+        }
+
+        BufferPtr data = item.second.save(tileEnvelope(item.first),
+                                          m_compressTiles);
+        tile->SetField(tile->GetFieldIndex(OVR_TILE_KEY), data->size(),
+                       data->data());
+
+        OGRErr err = create ? m_ovrTable->CreateFeature(tile) :
+                              m_ovrTable->SetFeature(tile);
+        if(err != OGRERR_NONE) {
+            errorMessage(COD_INSERT_FAILED, _("Failed to create feature"));
+            result = false;
+        }
+        else if(create) {
+            flushedTiles.insert(item.first);
+        }
+
+        progress.onProgress(COD_IN_PROCESS, counter/tileCount,
+                            _("Save tiles ..."));
+        counter++;
+    }
+
+    return result;
+}
+
+int FeatureClass::createOverviews(const Progress &progress, const Options &options)
+{
+    CPLDebug("ngstore", "start create overviews");
+    loadProperties();
+    clearGenTiles();
+    m_genTilesPeakMemory = 0;
     bool force = options.boolOption("FORCE", false);
     if(!force && hasOverviews()) {
-        return true;
+        return COD_SUCCESS;
     }
 
     Dataset* parentDS = dynamic_cast<Dataset*>(m_parent);
     if(nullptr == parentDS) {
         progress.onProgress(COD_CREATE_FAILED, 0.0,
                             _("Unsupported feature class"));
-        return errorMessage(_("Unsupported feature class"));
+        return errorMessage(COD_CREATE_FAILED, _("Unsupported feature class"));
     }
 
     if(nullptr == m_ovrTable) {
@@ -389,18 +864,37 @@ bool FeatureClass::createOverviews(const Progress &progress, const Options &opti
         parentDS->clearOverviewsTable(name());
     }
 
-    // Drop index
-    parentDS->dropOverviewsTableIndex(name());
+    // If memory limit is set, the tiles are flushed to the overviews table
+    // during tiling and merged with already stored ones. The index is needed
+    // to find them.
+    size_t maxMemory = static_cast<size_t>(std::max(0,
+                options.intOption(MAX_MEMORY_MB_OPTION, 0))) * BYTES_IN_MB;
+    bool streaming = maxMemory > 0;
+    if(streaming) {
+        parentDS->createOverviewsTableIndex(name());
+    }
+    else {
+        // Drop index
+        parentDS->dropOverviewsTableIndex(name());
+    }
 
     // Fill overview layer with data
     const CPLString &zoomLevelListStr = options.stringOption(
                 ZOOM_LEVELS_OPTION, "");
     fillZoomLevels(zoomLevelListStr);
     if(m_zoomLevels.empty()) {
-        return true;
+        return COD_SUCCESS;
     }
 
     setProperty("zoom_levels", zoomLevelListStr, NG_ADDITIONS_KEY);
+    m_compressTiles = options.boolOption(COMPRESS_TILES_OPTION, false);
+    setProperty(COMPRESS_TILES_KEY, m_compressTiles ? "ON" : "OFF",
+                NG_ADDITIONS_KEY);
+
+    // In bottom up mode the features are tiled only for the deepest zoom
+    // level. Other levels are derived from the tiles of the next deeper level.
+    bool bottomUp = options.boolOption(BOTTOM_UP_OPTION, false) &&
+            m_zoomLevels.size() > 1;
 
     // Tile and simplify geometry
     progress.onProgress(COD_IN_PROCESS, 0.0,
@@ -410,71 +904,120 @@ bool FeatureClass::createOverviews(const Progress &progress, const Options &opti
     CPLDebug("ngstore", "fill pool create overviews");
     ThreadPool threadPool;
     threadPool.init(getNumberThreads(), tilingDataJobThreadFunc);
+    GIntBig count = featureCount();
     setIgnoredFields(m_ignoreFields);
     reset();
 
-
+    m_creatingOvr = true;
+    std::set<Tile> flushedTiles;
+    Progress newProgress(progress);
+    newProgress.setTotalSteps(bottomUp ? 3 : 2);
+    newProgress.setStep(0);
+    double counter = 0.0;
+    bool canceled = false;
     FeaturePtr feature;
     while((feature = nextFeature())) {
-        threadPool.addThreadData(new TilingData(this, feature, true));
+        threadPool.addThreadData(new TilingData(this, feature, bottomUp, true));
+        counter++;
+
+        // Wait for the pool each time a batch of features has been fed
+        if(!streaming ||
+                static_cast<size_t>(counter) % OVR_FEATURE_BATCH_SIZE != 0) {
+            continue;
+        }
+
+        threadPool.waitComplete(Progress());
+        size_t memory = genTilesMemory();
+        if(memory >= maxMemory) {
+            flushOverviewTiles(flushedTiles);
+        }
+
+        if(!newProgress.onProgress(COD_IN_PROCESS, counter / count,
+                _("Tiling features ... Peak tiles memory %.1f Mb"),
+                static_cast<double>(std::max(memory, m_genTilesPeakMemory)) /
+                                   BYTES_IN_MB)) {
+            canceled = true;
+            break;
+        }
     }
 
-    Progress newProgress(progress);
-    newProgress.setTotalSteps(2);
-    newProgress.setStep(0);
-    threadPool.waitComplete(newProgress);
+    if(streaming || canceled) {
+        threadPool.waitComplete(Progress());
+    }
+    else if(!threadPool.waitComplete(newProgress)) {
+        canceled = true;
+    }
     threadPool.clearThreadData();
 
     setIgnoredFields();
     reset();
 
-    // Save tiles
-    m_creatingOvr = true;
-    parentDS->lockExecuteSql(true);
-    parentDS->startBatchOperation();
+    if(canceled) {
+        return cancelOverviews(progress);
+    }
 
+    // Save tiles
     CPLDebug("ngstore", "finish create overviews");
-    double counter = 0.0;
+    parentDS->lockExecuteSql(true);
     newProgress.setStep(1);
-    for(auto item : m_genTiles) {
-        if(!item.second.isValid() || item.second.empty()) {
-            continue;
-        }
-        BufferPtr data = item.second.save();
-
-        FeaturePtr newFeature = OGRFeature::CreateFeature(
-                    m_ovrTable->GetLayerDefn() );
-
-        newFeature->SetField(OVR_ZOOM_KEY, item.first.z);
-        newFeature->SetField(OVR_X_KEY, item.first.x);
-        newFeature->SetField(OVR_Y_KEY, item.first.y);
-        newFeature->SetField(newFeature->GetFieldIndex(OVR_TILE_KEY), data->size(),
-                          data->data());
-
-//        CPLDebug("ngstore", "Tile size to store %d", data->size());
+    flushOverviewTiles(flushedTiles, newProgress);
+
+    if(bottomUp) {
+        newProgress.setStep(2);
+        bool precisePixelSize = !(OGR_GT_Flatten(geometryType()) == wkbPoint ||
+                                  OGR_GT_Flatten(geometryType()) == wkbMultiPoint);
+        double levelCount = m_zoomLevels.size() - 1;
+        counter = 0.0;
+        unsigned char childZoom = *m_zoomLevels.rbegin();
+        for(auto it = std::next(m_zoomLevels.rbegin());
+            it != m_zoomLevels.rend(); ++it) {
+            unsigned char zoom = *it;
+            if(!newProgress.onProgress(COD_IN_PROCESS, counter / levelCount,
+                    _("Derive zoom level %d from zoom level %d"),
+                    zoom, childZoom)) {
+                parentDS->lockExecuteSql(false);
+                return cancelOverviews(progress);
+            }
 
-        if(m_ovrTable->CreateFeature(newFeature) != OGRERR_NONE) {
-            errorMessage(COD_INSERT_FAILED, _("Failed to create feature"));
+            deriveOverviewZoom(zoom, childZoom,
+                               pixelSize(zoom, precisePixelSize));
+            flushOverviewTiles(flushedTiles);
+            childZoom = zoom;
+            counter++;
         }
-
-        newProgress.onProgress(COD_IN_PROCESS, counter/m_genTiles.size(),
-                               _("Save tiles ..."));
-        counter++;
     }
 
-    parentDS->stopBatchOperation();
-    m_genTiles.clear();
-
     // Create index
     parentDS->createOverviewsTableIndex(name());
     parentDS->lockExecuteSql(false);
     m_creatingOvr = false;
 
     progress.onProgress(COD_FINISHED, 1.0,
-                        _("Finish tiling and simplifying geometry"));
+                        _("Finish tiling and simplifying geometry. Peak tiles memory %.1f Mb"),
+                        static_cast<double>(m_genTilesPeakMemory) / BYTES_IN_MB);
 
     CPLDebug("ngstore", "finish create overviews");
-    return true;
+    return COD_SUCCESS;
+}
+
+int FeatureClass::cancelOverviews(const Progress &progress)
+{
+    // Partial overviews are not usable, so drop whatever was tiled or flushed.
+    // Without the overviews table the layer is tiled on the fly.
+    clearGenTiles();
+    Dataset* parentDS = dynamic_cast<Dataset*>(m_parent);
+    if(nullptr != parentDS) {
+        parentDS->destroyOverviewsTable(name());
+    }
+    m_ovrTable = nullptr;
+    m_zoomLevels.clear();
+    setProperty("zoom_levels", "", NG_ADDITIONS_KEY);
+    m_creatingOvr = false;
+
+    progress.onProgress(COD_CANCELED, 0.0,
+                        _("Create overviews canceled"));
+    CPLDebug("ngstore", "create overviews canceled");
+    return COD_CANCELED;
 }
 
 VectorTile FeatureClass::getTile(const Tile& tile, const Envelope& tileExtent)
@@ -485,6 +1028,7 @@ VectorTile FeatureClass::getTile(const Tile& tile, const Envelope& tileExtent)
         return vtile;
     }
 
+    loadProperties();
     if(!extent().intersects(tileExtent)) {
         return vtile;
     }
@@ -528,33 +1072,54 @@ VectorTile FeatureClass::getTile(const Tile& tile, const Envelope& tileExtent)
         extEnv = tileExtent.toOgrEnvelope();
     }
 
-    // Lock threads here    
-    dataset->lockExecuteSql(true);
-    CPLAcquireMutex(m_featureMutex, 10.5);
-    setIgnoredFields(m_ignoreFields);
-    GeometryPtr extGeom = tileExtent.toGeometry(getSpatialReference());
-    setSpatialFilter(extGeom);
-    //reset();
+    // The locks are taken only to open or build the index, so render threads
+    // are not serialized if the index is disabled or already loaded
+    SpatialIndexPtr index;
+    if(!m_fastSpatialFilter &&
+            CPLTestBool(CPLGetConfigOption(SPATIAL_INDEX_OPTION, "NO"))) {
+        index = cachedSpatialIndex();
+        if(!index) {
+            DatasetExecuteSQLLockHolder holder(dataset);
+            CPLMutexHolder featureHolder(m_featureMutex);
+            index = spatialIndex();
+        }
+    }
+
+    // Cursor reads through own connection if dataset supports it, so tiles
+    // are filled in parallel
     FeaturePtr feature;
-    while((feature = nextFeature())) {
-        if(m_fastSpatialFilter) {
-            features.push_back(feature);
-        }
-        else {
-            OGRGeometry* geom = feature->GetGeometryRef();
-            if(geom) {
-                OGREnvelope env;
-                geom->getEnvelope(&env);
-                if(env.IsInit() && env.Intersects(extEnv)) {
+    if(index) {
+        // Read only features found in the spatial index
+        FeatureCursorPtr cursor = openCursor(nullptr, nullptr, m_ignoreFields);
+        if(cursor) {
+            for(GIntBig fid : index->search(tileExtent)) {
+                feature = cursor->feature(fid);
+                if(feature) {
                     features.push_back(feature);
                 }
             }
         }
     }
-    setIgnoredFields();
-    setSpatialFilter();
-    dataset->lockExecuteSql(false);
-    CPLReleaseMutex(m_featureMutex);
+    else {
+        GeometryPtr extGeom = tileExtent.toGeometry(getSpatialReference());
+        FeatureCursorPtr cursor = openCursor(nullptr, extGeom.get(),
+                                             m_ignoreFields);
+        while(cursor && (feature = cursor->next())) {
+            if(m_fastSpatialFilter) {
+                features.push_back(feature);
+            }
+            else {
+                OGRGeometry* geom = feature->GetGeometryRef();
+                if(geom) {
+                    OGREnvelope env;
+                    geom->getEnvelope(&env);
+                    if(env.IsInit() && env.Intersects(extEnv)) {
+                        features.push_back(feature);
+                    }
+                }
+            }
+        }
+    }
 
     while(!features.empty()) {
         feature = features.back();
@@ -594,6 +1159,38 @@ VectorTile FeatureClass::getTile(const Tile& tile, const Envelope& tileExtent)
     return vtile;
 }
 
+VectorTileView FeatureClass::getTileView(const Tile& tile,
+                                         const Envelope& tileExtent)
+{
+    VectorTileView view;
+    if(nullptr == dynamic_cast<Dataset*>(m_parent) || m_creatingOvr) {
+        return view;
+    }
+
+    loadProperties();
+    if(!extent().intersects(tileExtent)) {
+        return view;
+    }
+
+    if(hasOverviews() && tile.z <= *m_zoomLevels.rbegin()) {
+        FeaturePtr ovrTile = readTileFeature(tile);
+        if(ovrTile) {
+            int size = 0;
+            GByte* data = ovrTile->GetFieldAsBinary(
+                        ovrTile->GetFieldIndex(OVR_TILE_KEY), &size);
+            view.load(data, static_cast<size_t>(size));
+        }
+        return view;
+    }
+
+    // Tiling on the fly
+    VectorTile vtile = getTile(tile, tileExtent);
+    if(!vtile.empty()) {
+        view.load(vtile.save());
+    }
+    return view;
+}
+
 VectorTileItemArray FeatureClass::tileGeometry(GIntBig fid, GEOSGeometryPtr geom,
                                                const Envelope& env) const
 {
@@ -647,11 +1244,140 @@ void FeatureClass::setSpatialFilter(double minX, double minY,
     }
 }
 
-Envelope FeatureClass::extent() const
+Envelope FeatureClass::extent()
 {
+    loadExtent();
     return m_extent;
 }
 
+void FeatureClass::loadProperties()
+{
+    if(m_propertiesLoaded || nullptr == m_layer) {
+        return;
+    }
+
+    // Read without the properties mutex, property access locks the dataset
+    CPLString zoomLevels = property("zoom_levels", "", NG_ADDITIONS_KEY);
+    bool compressTiles = EQUAL(property(COMPRESS_TILES_KEY, "OFF",
+                                        NG_ADDITIONS_KEY), "ON");
+    std::vector<const char*> ignoreFields;
+    bool fastSpatialFilter;
+    {
+        DatasetExecuteSQLLockHolder holder(dynamic_cast<Dataset*>(m_parent));
+        OGRFeatureDefn* defn = m_layer->GetLayerDefn();
+        for(int i = 0; i < defn->GetFieldCount(); ++i) {
+            OGRFieldDefn* fld = defn->GetFieldDefn(i);
+            ignoreFields.push_back(fld->GetNameRef());
+        }
+        ignoreFields.push_back("OGR_STYLE");
+        fastSpatialFilter = m_layer->TestCapability(OLCFastSpatialFilter) == 1;
+    }
+
+    CPLMutexHolder holder(m_propertiesMutex);
+    if(m_propertiesLoaded) {
+        return;
+    }
+    fillZoomLevels(zoomLevels);
+    m_compressTiles = compressTiles;
+    m_ignoreFields = ignoreFields;
+    m_fastSpatialFilter = fastSpatialFilter;
+    m_propertiesLoaded = true;
+}
+
+void FeatureClass::loadExtent()
+{
+    if(m_extentLoaded || nullptr == m_layer) {
+        return;
+    }
+
+    Envelope extent;
+    if(!readStoredExtent(extent)) {
+        Dataset* dataset = dynamic_cast<Dataset*>(m_parent);
+        DatasetExecuteSQLLockHolder holder(dataset);
+        CPLMutexHolder featureHolder(m_featureMutex);
+        OGREnvelope env;
+        if(m_layer->GetExtent(&env, 0) == OGRERR_NONE ||
+            m_layer->GetExtent(&env, 1) == OGRERR_NONE) {
+            extent = env;
+            if(nullptr != dataset && !dataset->isReadOnly()) {
+                storeExtent(extent);
+            }
+        }
+        else {
+            CPLDebug("ngstore", "GetExent failed");
+        }
+    }
+
+    CPLMutexHolder holder(m_propertiesMutex);
+    if(!m_extentLoaded) {
+        m_extent = extent;
+        m_extentLoaded = true;
+    }
+}
+
+void FeatureClass::mergeExtent(const Envelope& env)
+{
+    if(!env.isInit()) {
+        return;
+    }
+    loadExtent();
+    CPLMutexHolder holder(m_propertiesMutex);
+    if(!m_extent.isInit() || !m_extent.contains(env)) {
+        m_extent.merge(env);
+        m_extentChanged = true;
+    }
+}
+
+void FeatureClass::shrinkExtent(const Envelope& env)
+{
+    if(!env.isInit()) {
+        return;
+    }
+
+    // Only the geometry lying on the extent boundary may shrink it
+    loadExtent();
+    bool onBoundary;
+    {
+        CPLMutexHolder holder(m_propertiesMutex);
+        onBoundary = env.minX() <= m_extent.minX() ||
+                env.minY() <= m_extent.minY() ||
+                env.maxX() >= m_extent.maxX() ||
+                env.maxY() >= m_extent.maxY();
+    }
+    if(onBoundary) {
+        invalidateExtent();
+    }
+}
+
+void FeatureClass::flushExtent()
+{
+    Envelope extent;
+    {
+        CPLMutexHolder holder(m_propertiesMutex);
+        if(!m_extentChanged) {
+            return;
+        }
+        m_extentChanged = false;
+        extent = m_extent;
+    }
+    storeExtent(extent);
+}
+
+/**
+ * @brief FeatureClass::invalidateExtent Drops the cached and the stored extent.
+ * It is recalculated from the features on next request.
+ */
+void FeatureClass::invalidateExtent()
+{
+    {
+        CPLMutexHolder holder(m_propertiesMutex);
+        m_extent = Envelope();
+        m_extentChanged = false;
+        m_extentLoaded = false;
+    }
+    storeExtent(Envelope());
+}
+
 const char* FeatureClass::geometryTypeName(OGRwkbGeometryType type,
                                                 GeometryReportType reportType)
 {
@@ -812,6 +1538,126 @@ std::vector<OGRwkbGeometryType> FeatureClass::geometryTypes()
     return out;
 }
 
+/**
+ * @brief FeatureClass::spatialIndex Returns spatial index for the feature
+ * class without fast spatial filter. The index is opened from the file near
+ * the dataset or built and saved if the file is absent or older than the
+ * dataset. Caller must hold the feature mutex.
+ * @return Spatial index or empty pointer if the index is not needed or
+ * not enabled by NGS_SPATIAL_INDEX config option (off by default)
+ */
+SpatialIndexPtr FeatureClass::spatialIndex()
+{
+    loadProperties();
+    if(m_fastSpatialFilter || nullptr == m_layer ||
+            !CPLTestBool(CPLGetConfigOption(SPATIAL_INDEX_OPTION, "NO"))) {
+        return SpatialIndexPtr();
+    }
+
+    GIntBig sourceTime = spatialIndexSourceTime();
+    if(m_spatialIndex && m_spatialIndex->sourceTime() == sourceTime) {
+        return m_spatialIndex;
+    }
+
+    CPLString indexPath = spatialIndexPath();
+    SpatialIndexPtr index(new SpatialIndex);
+    if(!indexPath.empty() && index->open(indexPath) &&
+            index->sourceTime() == sourceTime) {
+        m_spatialIndex = index;
+        m_spatialIndexReset = false;
+        return m_spatialIndex;
+    }
+
+    CPLDebug("ngstore", "Build spatial index for %s", m_name.c_str());
+    std::vector<SpatialIndex::Item> items;
+    setIgnoredFields(m_ignoreFields);
+    m_layer->SetSpatialFilter(nullptr);
+    m_layer->ResetReading();
+    FeaturePtr feature;
+    while((feature = m_layer->GetNextFeature())) {
+        OGRGeometry* geom = feature->GetGeometryRef();
+        if(nullptr == geom) {
+            continue;
+        }
+        OGREnvelope env;
+        geom->getEnvelope(&env);
+        if(!env.IsInit()) {
+            continue;
+        }
+        SpatialIndex::Item item = { env.MinX, env.MinY, env.MaxX, env.MaxY,
+                                    static_cast<GUIntBig>(feature->GetFID()) };
+        items.push_back(item);
+    }
+    m_layer->ResetReading();
+    setIgnoredFields();
+
+    if(!index->build(items, sourceTime)) {
+        return SpatialIndexPtr();
+    }
+    if(!indexPath.empty()) {
+        index->save(indexPath);
+    }
+    m_spatialIndex = index;
+    m_spatialIndexReset = false;
+    return m_spatialIndex;
+}
+
+SpatialIndexPtr FeatureClass::cachedSpatialIndex() const
+{
+    SpatialIndexPtr index;
+    {
+        CPLMutexHolder holder(m_featureMutex);
+        index = m_spatialIndex;
+    }
+    if(index && index->sourceTime() == spatialIndexSourceTime()) {
+        return index;
+    }
+    return SpatialIndexPtr();
+}
+
+GIntBig FeatureClass::spatialIndexSourceTime() const
+{
+    VSIStatBufL sbuf;
+    if(nullptr != m_parent && !m_parent->path().empty() &&
+            VSIStatL(m_parent->path(), &sbuf) == 0) {
+        return static_cast<GIntBig>(sbuf.st_mtime);
+    }
+    return 0;
+}
+
+CPLString FeatureClass::spatialIndexPath() const
+{
+    if(nullptr == m_parent || m_parent->path().empty()) {
+        return "";
+    }
+    const CPLString& path = m_parent->path();
+    return CPLFormFilename(CPLGetPath(path),
+                           CPLSPrintf("%s_%s", CPLGetBasename(path),
+                                      m_name.c_str()), SPATIAL_INDEX_EXT);
+}
+
+void FeatureClass::resetSpatialIndex()
+{
+    loadProperties();
+    if(m_fastSpatialFilter) {
+        return;
+    }
+
+    // Index is dropped once after it was built or opened, so edits of a
+    // batch operation don't touch the file each time
+    CPLMutexHolder holder(m_featureMutex);
+    if(m_spatialIndexReset) {
+        return;
+    }
+    m_spatialIndexReset = true;
+    m_spatialIndex.reset();
+    CPLString indexPath = spatialIndexPath();
+    VSIStatBufL sbuf;
+    if(!indexPath.empty() && VSIStatL(indexPath, &sbuf) == 0) {
+        VSIUnlink(indexPath);
+    }
+}
+
 bool FeatureClass::destroy()
 {
     Dataset * const dataset = dynamic_cast<Dataset*>(m_parent);
@@ -823,6 +1669,7 @@ bool FeatureClass::destroy()
         m_ovrTable->ResetReading();
     }
     m_layer->SetSpatialFilter(nullptr);
+    resetSpatialIndex();
     CPLString name = m_name;
     if(!Table::destroy()) {
         return false;
@@ -861,6 +1708,7 @@ bool FeatureClass::insertFeature(const FeaturePtr& feature, bool logEdits)
     if(!result) {
         return result;
     }
+    resetSpatialIndex();
 
     OGRGeometry* geom = feature->GetGeometryRef();
     if(nullptr == geom) {
@@ -870,38 +1718,119 @@ bool FeatureClass::insertFeature(const FeaturePtr& feature, bool logEdits)
     geom->getEnvelope(&env);
     Envelope extentBase = env;
     extentBase.fix();
-    m_extent.merge(extentBase);
+    mergeExtent(extentBase);
 
-    Dataset * const dataset = dynamic_cast<Dataset*>(m_parent);
-    if(nullptr == dataset || dataset->isBatchOperation()) {
+    addDirtyTiles(feature->GetFID(), extentBase);
+    flushOverviewsIfNoBatch();
+
+    return result;
+}
+
+bool FeatureClass::insertFeatures(const std::vector<FeaturePtr>& features,
+                                  bool logEdits)
+{
+    bool result = Table::insertFeatures(features, logEdits);
+    if(!result || features.empty()) {
         return result;
     }
+    resetSpatialIndex();
 
-    bool precisePixelSize = !(OGR_GT_Flatten(geom->getGeometryType()) == wkbPoint ||
-                              OGR_GT_Flatten(geom->getGeometryType()) == wkbMultiPoint);
+    for(const FeaturePtr& feature : features) {
+        OGRGeometry* geom = feature->GetGeometryRef();
+        if(nullptr == geom) {
+            continue;
+        }
+        OGREnvelope env;
+        geom->getEnvelope(&env);
+        Envelope extentBase = env;
+        extentBase.fix();
+        mergeExtent(extentBase);
 
-    GEOSGeometryPtr geosGeom(new GEOSGeometryWrap(geom));
-    GIntBig fid = feature->GetFID();
+        addDirtyTiles(feature->GetFID(), extentBase);
+    }
+    flushOverviewsIfNoBatch();
 
-    auto zoomLevelsList = zoomLevels();
-    for(auto it = zoomLevelsList.rbegin(); it != zoomLevelsList.rend(); ++it) {
-        unsigned char zoomLevel = *it;
-        Envelope extent = extraExtentForZoom(zoomLevel, extentBase);
+    return result;
+}
+
+void FeatureClass::addDirtyTiles(GIntBig fid, const Envelope& env)
+{
+    loadProperties();
+    if(m_zoomLevels.empty() || !env.isInit() || m_creatingOvr ||
+            !getTilesTable()) {
+        return;
+    }
+
+    CPLMutexHolder holder(m_dirtyTilesMutex, 150.0);
+    for(auto zoomLevel : m_zoomLevels) {
+        Envelope extent = extraExtentForZoom(zoomLevel, env);
         std::vector<TileItem> items =
                 MapTransform::getTilesForExtent(extent, zoomLevel, false, true);
+        for(const auto& tileItem : items) {
+            DirtyTile& dirtyTile = m_dirtyTiles[tileItem.tile];
+            dirtyTile.env = tileItem.env;
+            dirtyTile.ids.insert(fid);
+        }
+    }
+}
 
-        double step = FeatureClass::pixelSize(zoomLevel, precisePixelSize);
-        geosGeom->simplify(step);
+void FeatureClass::flushOverviewsIfNoBatch()
+{
+    Dataset * const dataset = dynamic_cast<Dataset*>(m_parent);
+    if(nullptr != dataset && !dataset->isBatchOperation()) {
+        flushOverviews();
+    }
+}
 
-        for(auto tileItem : items) {
+bool FeatureClass::flushOverviews()
+{
+    flushExtent();
 
-            Envelope ext = tileItem.env;
-            ext.resize(TILE_RESIZE);
+    std::map<Tile, DirtyTile> dirtyTiles;
+    CPLAcquireMutex(m_dirtyTilesMutex, 150.0);
+    dirtyTiles.swap(m_dirtyTiles);
+    CPLReleaseMutex(m_dirtyTilesMutex);
 
-            auto vItem = tileGeometry(fid, geosGeom, ext);
+    if(dirtyTiles.empty() || !getTilesTable()) {
+        return true;
+    }
+
+    // Load geometry of each edited feature once. Deleted features and
+    // features without geometry are only removed from tiles.
+    std::map<GIntBig, GEOSGeometryPtr> geometries;
+    for(const auto& dirtyTile : dirtyTiles) {
+        for(GIntBig id : dirtyTile.second.ids) {
+            if(geometries.find(id) != geometries.end()) {
+                continue;
+            }
+            FeaturePtr feature = getFeature(id);
+            OGRGeometry* geom = feature ? feature->GetGeometryRef() : nullptr;
+            geometries[id] = nullptr == geom ? GEOSGeometryPtr() :
+                                               GEOSGeometryPtr(new GEOSGeometryWrap(geom));
+        }
+    }
+
+    bool precisePixelSize = !(OGR_GT_Flatten(geometryType()) == wkbPoint ||
+                              OGR_GT_Flatten(geometryType()) == wkbMultiPoint);
+
+    DatasetExecuteSQLLockHolder holder(dynamic_cast<Dataset*>(m_parent));
+    bool result = true;
+    for(auto it = m_zoomLevels.rbegin(); it != m_zoomLevels.rend(); ++it) {
+        unsigned char zoomLevel = *it;
+        double step = FeatureClass::pixelSize(zoomLevel, precisePixelSize);
+        for(auto& geometry : geometries) {
+            if(geometry.second) {
+                geometry.second->simplify(step);
+            }
+        }
 
-            FeaturePtr tile = getTileFeature(tileItem.tile);
-            VectorTile  vtile;
+        for(const auto& dirtyTile : dirtyTiles) {
+            if(dirtyTile.first.z != zoomLevel) {
+                continue;
+            }
+
+            FeaturePtr tile = getTileFeature(dirtyTile.first);
+            VectorTile vtile;
             bool create = true;
             if(tile) {
                 int size = 0;
@@ -914,25 +1843,39 @@ bool FeatureClass::insertFeature(const FeaturePtr& feature, bool logEdits)
             else {
                 tile = OGRFeature::CreateFeature(m_ovrTable->GetLayerDefn());
 
-                tile->SetField(OVR_ZOOM_KEY, tileItem.tile.z);
-                tile->SetField(OVR_X_KEY, tileItem.tile.x);
-                tile->SetField(OVR_Y_KEY, tileItem.tile.y);
+                tile->SetField(OVR_ZOOM_KEY, dirtyTile.first.z);
+                tile->SetField(OVR_X_KEY, dirtyTile.first.x);
+                tile->SetField(OVR_Y_KEY, dirtyTile.first.y);
+            }
+
+            Envelope env = dirtyTile.second.env;
+            env.resize(TILE_RESIZE);
+            vtile.remove(dirtyTile.second.ids);
+            for(GIntBig id : dirtyTile.second.ids) {
+                const GEOSGeometryPtr& geometry = geometries[id];
+                if(geometry) {
+                    vtile.add(tileGeometry(id, geometry, env), true);
+                }
             }
-            vtile.add(vItem, true);
 
             // Add tile back
-            if(vtile.isValid()) {
-                BufferPtr data = vtile.save();
+            if(vtile.isValid() && !vtile.empty()) {
+                BufferPtr data = vtile.save(tileEnvelope(dirtyTile.first),
+                                            m_compressTiles);
                 tile->SetField(tile->GetFieldIndex(OVR_TILE_KEY), data->size(),
                                                      data->data());
 
                 if(create) {
-                    createTileFeature(tile);
+                    result = createTileFeature(tile) && result;
                 }
                 else {
-                    setTileFeature(tile);
+                    result = setTileFeature(tile) && result;
                 }
             }
+            else if(!create) {
+                result = m_ovrTable->DeleteFeature(tile->GetFID()) ==
+                        OGRERR_NONE && result;
+            }
         }
     }
 
@@ -972,17 +1915,23 @@ bool FeatureClass::updateFeature(const FeaturePtr& feature, bool logEdits)
     OGRGeometry* originalGeom = updateFeature->GetGeometryRef();
     OGRGeometry* newGeom = feature->GetGeometryRef();
     Envelope extentBase;
+    Envelope originalExtent;
 
     if(nullptr != originalGeom) {
         OGREnvelope env;
         originalGeom->getEnvelope(&env);
         extentBase = env;
+        originalExtent = env;
+        originalExtent.fix();
     }
 
+    Envelope newExtent;
     if(nullptr != newGeom) {
         OGREnvelope env;
         newGeom->getEnvelope(&env);
         extentBase.merge(env);
+        newExtent = env;
+        newExtent.fix();
     }
 
     extentBase.fix();
@@ -990,75 +1939,15 @@ bool FeatureClass::updateFeature(const FeaturePtr& feature, bool logEdits)
 
     bool result = Table::updateFeature(feature, logEdits);
 
-    m_extent.merge(extentBase);
-
     if(!result) {
         return result;
-    }    
-
-    Dataset * const dataset = dynamic_cast<Dataset*>(m_parent);
-    if(nullptr == dataset || dataset->isBatchOperation()) {
-        return result;
     }
+    resetSpatialIndex();
+    shrinkExtent(originalExtent);
+    mergeExtent(newExtent);
 
-    bool precisePixelSize = !(OGR_GT_Flatten(geometryType()) == wkbPoint ||
-                              OGR_GT_Flatten(geometryType()) == wkbMultiPoint);
-
-    GEOSGeometryPtr geosGeom(new GEOSGeometryWrap(newGeom));
-    GIntBig fid = feature->GetFID();
-
-    auto zoomLevelsList = zoomLevels();
-    for(auto it = zoomLevelsList.rbegin(); it != zoomLevelsList.rend(); ++it) {
-        unsigned char zoomLevel = *it;
-        Envelope extent = extraExtentForZoom(zoomLevel, extentBase);
-
-        std::vector<TileItem> items =
-                MapTransform::getTilesForExtent(extent, zoomLevel, false, true);
-
-        double step = FeatureClass::pixelSize(zoomLevel, precisePixelSize);
-        geosGeom->simplify(step);
-
-        for(auto tileItem : items) {
-            FeaturePtr tile = getTileFeature(tileItem.tile);
-            VectorTile  vtile;
-            bool create = true;
-            if(tile) {
-                int size = 0;
-                GByte* data = tile->GetFieldAsBinary(tile->GetFieldIndex(OVR_TILE_KEY), &size);
-                Buffer buff(data, size, false);
-                vtile.load(buff);
-                create = false;
-            }
-            else {
-                tile = OGRFeature::CreateFeature(m_ovrTable->GetLayerDefn());
-
-                tile->SetField(OVR_ZOOM_KEY, tileItem.tile.z);
-                tile->SetField(OVR_X_KEY, tileItem.tile.x);
-                tile->SetField(OVR_Y_KEY, tileItem.tile.y);
-            }
-
-            vtile.remove(id);
-
-            Envelope env = tileItem.env;
-            env.resize(TILE_RESIZE);
-            auto vItem = tileGeometry(fid, geosGeom, env);
-            vtile.add(vItem, true);
-
-            // Add tile back
-            if(vtile.isValid()) {
-                BufferPtr data = vtile.save();
-                tile->SetField(tile->GetFieldIndex(OVR_TILE_KEY), data->size(),
-                                                     data->data());
-
-                if(create) {
-                    createTileFeature(tile);
-                }
-                else {
-                    setTileFeature(tile);
-                }
-            }
-        }
-    }
+    addDirtyTiles(id, extentBase);
+    flushOverviewsIfNoBatch();
 
     return result;
 }
@@ -1071,51 +1960,26 @@ bool FeatureClass::deleteFeature(GIntBig id, bool logEdits)
         return Table::deleteFeature(id, logEdits);
     }
 
+    Envelope extentBase;
     OGRGeometry* geom = deleteFeature->GetGeometryRef();
-    OGREnvelope env;
-    geom->getEnvelope(&env);
+    if(nullptr != geom) {
+        OGREnvelope env;
+        geom->getEnvelope(&env);
+        extentBase = env;
+        extentBase.fix();
+    }
 
     bool result = Table::deleteFeature(id, logEdits);
 
     if(!result) {
         return result;
     }
+    resetSpatialIndex();
+    shrinkExtent(extentBase);
 
-    Dataset * const dataset = dynamic_cast<Dataset*>(m_parent);
-    if(nullptr == dataset || dataset->isBatchOperation()) {
-        return result;
-    }
-
-    for(auto zoomLevel : zoomLevels()) {
-        Envelope extent = extraExtentForZoom(zoomLevel, env);
-        std::vector<TileItem> items =
-                MapTransform::getTilesForExtent(extent, zoomLevel, false, true);
-        for(auto tileItem : items) {
-            FeaturePtr tile = getTileFeature(tileItem.tile);
-
-            VectorTile  vtile;
-            if(tile) {
-                int size = 0;
-                GByte* data = tile->GetFieldAsBinary(tile->GetFieldIndex(OVR_TILE_KEY), &size);
-                Buffer buff(data, size, false);
-                if(vtile.load(buff)) {
-                    vtile.remove(id);
-                }
-            }
-
-            // Add tile back
-            if(vtile.isValid()) {
-                BufferPtr data = vtile.save();
-                tile->SetField(tile->GetFieldIndex(OVR_TILE_KEY), data->size(),
-                                                     data->data());
+    addDirtyTiles(id, extentBase);
+    flushOverviewsIfNoBatch();
 
-                setTileFeature(tile);
-            }
-            else if(tile) {
-                result = m_ovrTable->DeleteFeature(tile->GetFID());
-            }
-        }
-    }
     // Delete attachments
     result = deleteAttachments(id, logEdits);
     return result;
@@ -1125,6 +1989,12 @@ bool FeatureClass::deleteFeature(GIntBig id, bool logEdits)
 bool FeatureClass::deleteFeatures(bool logEdits)
 {
     if(Table::deleteFeatures(logEdits)) {
+        resetSpatialIndex();
+        invalidateExtent();
+        CPLAcquireMutex(m_dirtyTilesMutex, 150.0);
+        m_dirtyTiles.clear();
+        CPLReleaseMutex(m_dirtyTilesMutex);
+
         Dataset* dataset = dynamic_cast<Dataset*>(m_parent);
         if(nullptr != dataset) {
             return dataset->clearOverviewsTable(name());
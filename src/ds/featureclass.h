@@ -22,10 +22,13 @@
 #define NGSFEATUREDATASET_H
 
 #include <algorithm>
+#include <functional>
+#include <memory>
 
 #include "coordinatetransformation.h"
 #include "geometry.h"
 #include "ngstore/codes.h"
+#include "spatialindex.h"
 #include "table.h"
 #include "util/options.h"
 #include "util/threadpool.h"
@@ -37,6 +40,13 @@ constexpr double TILE_RESIZE = 1.1;
 class FeatureClass;
 typedef std::shared_ptr<FeatureClass> FeatureClassPtr;
 
+/**
+ * @brief FeatureClassSelector Returns destination feature class for features
+ * of the geometry type (wkbNone for features without geometry) or nullptr on
+ * error.
+ */
+typedef std::function<FeatureClass*(OGRwkbGeometryType)> FeatureClassSelector;
+
 /**
  * @brief The FeatureClass class
  */
@@ -65,21 +75,22 @@ public:
     void setSpatialFilter(const GeometryPtr& geom = GeometryPtr());
     void setSpatialFilter(double minX, double minY, double maxX, double maxY);
 
-    Envelope extent() const;
+    Envelope extent();
     virtual int copyFeatures(const FeatureClassPtr srcFClass,
                              const FieldMapPtr fieldMap,
                              OGRwkbGeometryType filterGeomType,
                              const Progress& progress = Progress(),
                              const Options& options = Options());
     bool hasOverviews() const;
-    bool createOverviews(const Progress& progress = Progress(),
-                         const Options& options = Options());
+    int createOverviews(const Progress& progress = Progress(),
+                        const Options& options = Options());
+    bool flushOverviews();
+    void invalidateExtent();
     VectorTile getTile(const Tile& tile, const Envelope& tileExtent = Envelope());
-    std::set<unsigned char> zoomLevels() const { return m_zoomLevels; }
-    void addOverviewItem(const Tile& tile, const VectorTileItemArray& items) {
-        CPLMutexHolder holder(m_genTileMutex, 150.0);
-        m_genTiles[tile].add(items, true);
-    }
+    VectorTileView getTileView(const Tile& tile,
+                               const Envelope& tileExtent = Envelope());
+    std::set<unsigned char> zoomLevels() { loadProperties(); return m_zoomLevels; }
+    void addOverviewItem(const Tile& tile, const VectorTileItemArray& items);
 
     // static
     static const char* geometryTypeName(OGRwkbGeometryType type,
@@ -88,6 +99,12 @@ public:
     static OGRFieldType fieldTypeFromName(const char* name);
     static double pixelSize(int zoom, bool precize = false);
     static Envelope extraExtentForZoom(unsigned char zoom, const Envelope& env);
+    static int copyFeaturesByType(const FeatureClassPtr srcFClass,
+                                  const FieldMapPtr fieldMap,
+                                  OGRwkbGeometryType filterGeomType,
+                                  const FeatureClassSelector& dstSelector,
+                                  const Progress& progress = Progress(),
+                                  const Options& options = Options());
 
     // Object interface
 public:
@@ -96,6 +113,8 @@ public:
     // Table interface
 public:
     virtual bool insertFeature(const FeaturePtr& feature, bool logEdits = true) override;
+    virtual bool insertFeatures(const std::vector<FeaturePtr>& features,
+                                bool logEdits = true) override;
     virtual bool updateFeature(const FeaturePtr& feature, bool logEdits = true) override;
     virtual bool deleteFeature(GIntBig id, bool logEdits = true) override;
     virtual bool deleteFeatures(bool logEdits = true) override;
@@ -104,6 +123,13 @@ protected:
     VectorTileItemArray tileGeometry(GIntBig fid, GEOSGeometryPtr geom,
                                      const Envelope& env) const;
     void fillZoomLevels(const char* zoomLevels = nullptr);
+    void loadProperties();
+    void loadExtent();
+    void mergeExtent(const Envelope& env);
+    void shrinkExtent(const Envelope& env);
+    void flushExtent();
+    virtual bool readStoredExtent(Envelope& /*extent*/) { return false; }
+    virtual void storeExtent(const Envelope& /*extent*/) {}
 /*
     void tileLine(GIntBig fid, OGRGeometry* geom, OGRGeometry* extent,
                   float step, VectorTileItemArray& vitemArray)  const;
@@ -117,25 +143,74 @@ protected:
 
     bool getTilesTable();
     FeaturePtr getTileFeature(const Tile& tile);
+    FeaturePtr readTileFeature(const Tile& tile);
     VectorTile getTileInternal(const Tile& tile);
     bool setTileFeature(FeaturePtr tile);
     bool createTileFeature(FeaturePtr tile);
+    bool flushOverviewTiles(std::set<Tile>& flushedTiles,
+                            const Progress& progress = Progress());
+    void addDirtyTiles(GIntBig fid, const Envelope& env);
+    void flushOverviewsIfNoBatch();
+    void deriveOverviewZoom(unsigned char zoom, unsigned char childZoom,
+                            double step);
+    SpatialIndexPtr spatialIndex();
+    SpatialIndexPtr cachedSpatialIndex() const;
+    CPLString spatialIndexPath() const;
+    GIntBig spatialIndexSourceTime() const;
+    void resetSpatialIndex();
 
     // static
 protected:
     static bool tilingDataJobThreadFunc(ThreadData *threadData);
+    static bool overviewTileJobThreadFunc(ThreadData *threadData);
 
 protected:
     OGRLayer* m_ovrTable;
     std::set<unsigned char> m_zoomLevels;
-    CPLMutex* m_genTileMutex;
     std::vector<const char*> m_ignoreFields;
     Envelope m_extent;
     bool m_fastSpatialFilter;
+    SpatialIndexPtr m_spatialIndex;
+    bool m_spatialIndexReset;
     bool m_creatingOvr;
+    bool m_compressTiles;
+
+    /**
+     * @brief The DirtyTile struct Overview tile and edited feature identifiers
+     * to update in it.
+     */
+    typedef struct _dirtyTile {
+        Envelope env;
+        FeatureIDs ids;
+    } DirtyTile;
+    std::map<Tile, DirtyTile> m_dirtyTiles;
+    CPLMutex* m_dirtyTilesMutex;
+    std::atomic<bool> m_propertiesLoaded;
+    std::atomic<bool> m_extentLoaded;
+    bool m_extentChanged;
+    CPLMutex* m_propertiesMutex;
+
+private:
+    void clearGenTiles();
+    int cancelOverviews(const Progress& progress);
+    size_t genTilesMemory() const;
 
 private:
-    std::map<Tile, VectorTile> m_genTiles;
+    /**
+     * @brief The GenTiles struct Tiles generated by one tiling thread. Each
+     * thread fills own tiles without locking, they are merged on flush.
+     */
+    typedef struct _genTiles {
+        std::map<Tile, VectorTile> tiles;
+        std::atomic<size_t> memory;
+    } GenTiles;
+
+    GenTiles* threadGenTiles();
+
+    std::map<GIntBig, std::unique_ptr<GenTiles>> m_genTiles;
+    CPLMutex* m_genTilesMutex;
+    std::atomic<GUIntBig> m_genTilesGeneration;
+    size_t m_genTilesPeakMemory;
 };
 
 }
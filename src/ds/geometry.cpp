@@ -20,6 +20,22 @@
  ****************************************************************************/
 #include "geometry.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define NGS_SNAP_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#define NGS_SNAP_NEON
+#include <arm_neon.h>
+#endif
+
+// gdal
+#include "cpl_conv.h"
+
 #include "earcut.hpp"
 #include "geos_c.h"
 
@@ -36,6 +52,34 @@ constexpr const char* MAP_MAX_Y_KEY = "max_y";
 
 constexpr unsigned short MAX_EDGE_INDEX = 65534;
 
+// Vector tile v2 format
+constexpr GUInt32 VECTOR_TILE_V2_MAGIC = 0x32545647; // "GVT2"
+constexpr GByte VECTOR_TILE_DEFLATE = 1;
+constexpr size_t VECTOR_TILE_MAX_SIZE = 64 * 1024 * 1024; // Inflated body limit
+constexpr size_t DEFLATE_MAX_RATIO = 1032; // Deflate maximum compression ratio
+constexpr double VECTOR_TILE_EXTENT = 8192.0;
+constexpr size_t VECTOR_TILE_ITEM_MIN_SIZE = 21; // 2d flag and five counts
+constexpr size_t VECTOR_TILE_V2_ITEM_MIN_SIZE = 6;
+
+/**
+ * @brief checkCount Checks the count read from the tile data. Each counted
+ * value takes at least valueSize bytes, so the count above the rest of the
+ * buffer means corrupted or truncated data.
+ */
+static bool checkCount(const Buffer& buffer, GUIntBig count, size_t valueSize)
+{
+    size_t size = static_cast<size_t>(buffer.size());
+    if(buffer.position() > size) {
+        return count == 0;
+    }
+    if(count > (size - buffer.position()) / valueSize) {
+        CPLDebug("ngstore", "Invalid vector tile count " CPL_FRMT_GUIB,
+                 count);
+        return false;
+    }
+    return true;
+}
+
 //------------------------------------------------------------------------------
 // VectorTileItem
 //------------------------------------------------------------------------------
@@ -49,12 +93,8 @@ VectorTileItem::VectorTileItem() :
 
 void VectorTileItem::removeId(GIntBig id)
 {
-    auto it = m_ids.find(id);
-    if(it != m_ids.end()) {
-        m_ids.erase(it);
-        if(m_ids.empty()) {
-            m_valid = false;
-        }
+    if(m_ids.erase(id) && m_ids.empty()) {
+        m_valid = false;
     }
 }
 
@@ -112,7 +152,7 @@ void VectorTileItem::save(Buffer* buffer)
         }
     }
 
-    // set<GIntBig> m_ids
+    // FeatureIDs m_ids
     buffer->put(static_cast<GUInt32>(m_ids.size()));
     for(auto id : m_ids) {
         buffer->put(id);
@@ -124,7 +164,10 @@ bool VectorTileItem::load(Buffer& buffer)
     m_2d = buffer.getByte();
     // vector<SimplePoint> m_points
     GUInt32 size = buffer.getULong();
-    for(GUInt32 i = 0; i < size; ++i) {
+    if(!checkCount(buffer, m_2d ? size : 0, sizeof(SimplePoint))) {
+        return false;
+    }
+    for(GUInt32 i = 0; i < size && m_2d; ++i) {
         if(m_2d) {
             float x = buffer.getFloat();
             float y = buffer.getFloat();
@@ -138,14 +181,23 @@ bool VectorTileItem::load(Buffer& buffer)
 
     // vector<unsigned short> m_indices
     size = buffer.getULong();
+    if(!checkCount(buffer, size, sizeof(unsigned short))) {
+        return false;
+    }
     for(GUInt32 i = 0; i < size; ++i) {
         m_indices.push_back(buffer.getUShort());
     }
 
     //vector<vector<unsigned short>> m_borderIndices
     size = buffer.getULong();
+    if(!checkCount(buffer, size, sizeof(GUInt32))) {
+        return false;
+    }
     for(GUInt32 i = 0; i < size; ++i) {
         GUInt32 size1 = buffer.getULong();
+        if(!checkCount(buffer, size1, sizeof(unsigned short))) {
+            return false;
+        }
         std::vector<unsigned short> array;
         for(GUInt32 j = 0; j < size1; ++j) {
             array.push_back(buffer.getUShort());
@@ -157,7 +209,10 @@ bool VectorTileItem::load(Buffer& buffer)
 
     // vector<SimplePoint> m_centroids
     size = buffer.getULong();
-    for(GUInt32 i = 0; i < size; ++i) {
+    if(!checkCount(buffer, m_2d ? size : 0, sizeof(SimplePoint))) {
+        return false;
+    }
+    for(GUInt32 i = 0; i < size && m_2d; ++i) {
         if(m_2d) {
             float x = buffer.getFloat();
             float y = buffer.getFloat();
@@ -169,8 +224,12 @@ bool VectorTileItem::load(Buffer& buffer)
         }
     }
 
-    // set<GIntBig> m_ids
+    // FeatureIDs m_ids
     size = buffer.getULong();
+    if(!checkCount(buffer, size, sizeof(GIntBig))) {
+        return false;
+    }
+    m_ids.reserve(size);
     for(GUInt32 i = 0; i < size; ++i) {
         m_ids.insert(buffer.getBig());
     }
@@ -179,6 +238,172 @@ bool VectorTileItem::load(Buffer& buffer)
     return true;
 }
 
+void VectorTileItem::save(Buffer* buffer, const OGRRawPoint& origin,
+                          double quantum)
+{
+    buffer->put(static_cast<GByte>(m_2d));
+
+    // vector<SimplePoint> m_points
+    GIntBig prevX = 0, prevY = 0;
+    buffer->putVarUInt(m_points.size());
+    for(auto point : m_points) {
+        if(m_2d) {
+            GIntBig x = static_cast<GIntBig>(
+                        std::llround((point.x - origin.x) / quantum));
+            GIntBig y = static_cast<GIntBig>(
+                        std::llround((point.y - origin.y) / quantum));
+            buffer->putVarInt(x - prevX);
+            buffer->putVarInt(y - prevY);
+            prevX = x;
+            prevY = y;
+        }
+        else {
+            // TODO: Add point with z support
+        }
+    }
+
+    // vector<unsigned short> m_indices
+    GIntBig prevIndex = 0;
+    buffer->putVarUInt(m_indices.size());
+    for(auto index : m_indices) {
+        buffer->putVarInt(index - prevIndex);
+        prevIndex = index;
+    }
+
+    //vector<vector<unsigned short>> m_borderIndices
+    buffer->putVarUInt(m_borderIndices.size());
+    for(const auto& borderIndexArray : m_borderIndices) {
+        prevIndex = 0;
+        buffer->putVarUInt(borderIndexArray.size());
+        for(auto borderIndex : borderIndexArray) {
+            buffer->putVarInt(borderIndex - prevIndex);
+            prevIndex = borderIndex;
+        }
+    }
+
+    // vector<SimplePoint> m_centroids
+    prevX = 0;
+    prevY = 0;
+    buffer->putVarUInt(m_centroids.size());
+    for(auto centroid : m_centroids) {
+        if(m_2d) {
+            GIntBig x = static_cast<GIntBig>(
+                        std::llround((centroid.x - origin.x) / quantum));
+            GIntBig y = static_cast<GIntBig>(
+                        std::llround((centroid.y - origin.y) / quantum));
+            buffer->putVarInt(x - prevX);
+            buffer->putVarInt(y - prevY);
+            prevX = x;
+            prevY = y;
+        }
+        else {
+            // TODO: Add point with z support
+        }
+    }
+
+    // FeatureIDs m_ids. The ids are sorted, so the deltas are positive.
+    GIntBig prevId = 0;
+    buffer->putVarUInt(m_ids.size());
+    for(auto id : m_ids) {
+        buffer->putVarInt(id - prevId);
+        prevId = id;
+    }
+}
+
+bool VectorTileItem::load(Buffer& buffer, const OGRRawPoint& origin,
+                          double quantum)
+{
+    m_2d = buffer.getByte();
+    // vector<SimplePoint> m_points
+    GIntBig x = 0, y = 0;
+    GUIntBig size = buffer.getVarUInt();
+    if(!checkCount(buffer, m_2d ? size : 0, 2)) {
+        return false;
+    }
+    m_points.reserve(static_cast<size_t>(size));
+    for(GUIntBig i = 0; i < size && m_2d; ++i) {
+        if(m_2d) {
+            x += buffer.getVarInt();
+            y += buffer.getVarInt();
+            SimplePoint pt = {static_cast<float>(origin.x + x * quantum),
+                              static_cast<float>(origin.y + y * quantum)};
+            m_points.push_back(pt);
+        }
+        else {
+            // TODO: Add point with z support
+        }
+    }
+
+    // vector<unsigned short> m_indices
+    GIntBig index = 0;
+    size = buffer.getVarUInt();
+    if(!checkCount(buffer, size, 1)) {
+        return false;
+    }
+    m_indices.reserve(static_cast<size_t>(size));
+    for(GUIntBig i = 0; i < size; ++i) {
+        index += buffer.getVarInt();
+        m_indices.push_back(static_cast<unsigned short>(index));
+    }
+
+    //vector<vector<unsigned short>> m_borderIndices
+    size = buffer.getVarUInt();
+    if(!checkCount(buffer, size, 1)) {
+        return false;
+    }
+    for(GUIntBig i = 0; i < size; ++i) {
+        index = 0;
+        GUIntBig size1 = buffer.getVarUInt();
+        if(!checkCount(buffer, size1, 1)) {
+            return false;
+        }
+        std::vector<unsigned short> array;
+        array.reserve(static_cast<size_t>(size1));
+        for(GUIntBig j = 0; j < size1; ++j) {
+            index += buffer.getVarInt();
+            array.push_back(static_cast<unsigned short>(index));
+        }
+        if(!array.empty()) {
+            m_borderIndices.push_back(array);
+        }
+    }
+
+    // vector<SimplePoint> m_centroids
+    x = 0;
+    y = 0;
+    size = buffer.getVarUInt();
+    if(!checkCount(buffer, m_2d ? size : 0, 2)) {
+        return false;
+    }
+    for(GUIntBig i = 0; i < size && m_2d; ++i) {
+        if(m_2d) {
+            x += buffer.getVarInt();
+            y += buffer.getVarInt();
+            SimplePoint pt = {static_cast<float>(origin.x + x * quantum),
+                              static_cast<float>(origin.y + y * quantum)};
+            m_centroids.push_back(pt);
+        }
+        else {
+            // TODO: Add point with z support
+        }
+    }
+
+    // FeatureIDs m_ids
+    GIntBig id = 0;
+    size = buffer.getVarUInt();
+    if(!checkCount(buffer, size, 1)) {
+        return false;
+    }
+    m_ids.reserve(static_cast<size_t>(size));
+    for(GUIntBig i = 0; i < size; ++i) {
+        id += buffer.getVarInt();
+        m_ids.insert(id);
+    }
+
+    m_valid = true;
+    return true;
+}
+
 bool VectorTileItem::isClosed() const
 {
     return isEqual(m_points.front().x, m_points.back().x) &&
@@ -187,65 +412,179 @@ bool VectorTileItem::isClosed() const
 
 void VectorTileItem::loadIds(const VectorTileItem &item)
 {
-    for(GIntBig id : item.m_ids) {
-        m_ids.insert(id);
-    }
+    m_ids.insert(item.m_ids.begin(), item.m_ids.end());
 }
 
-bool VectorTileItem::isIdsPresent(const std::set<GIntBig> &other, bool full) const
+bool VectorTileItem::isIdsPresent(const FeatureIDs &other, bool full) const
 {
     if(other.empty()) {
         return false;
     }
     if(full) {
-        return  std::includes(other.begin(), other.end(),
-                             m_ids.begin(), m_ids.end());
+        return other.includes(m_ids);
+    }
+    return other.intersects(m_ids);
+}
+
+FeatureIDs VectorTileItem::idsIntesect(const FeatureIDs &other) const
+{
+    return m_ids.intersection(other);
+}
+
+size_t VectorTileItem::memorySize() const
+{
+    // NOTE: This is an approximation. The allocator overhead is not counted.
+    size_t out = sizeof(VectorTileItem);
+    out += m_points.capacity() * sizeof(SimplePoint);
+    out += m_indices.capacity() * sizeof(unsigned short);
+    for(const auto& borderIndexArray : m_borderIndices) {
+        out += sizeof(std::vector<unsigned short>) +
+                borderIndexArray.capacity() * sizeof(unsigned short);
+    }
+    out += m_centroids.capacity() * sizeof(SimplePoint);
+    out += m_ids.memorySize();
+    return out;
+}
+
+/**
+ * @brief VectorTileItem::snapToGrid Moves points to the nodes of the grid with
+ * the step size. Consecutive duplicate points of the items without triangle
+ * indices (points and lines) are removed. A line collapsed to one point is
+ * invalidated, while a point or multipoint item stays valid. Polygon points
+ * are referenced by indices, so only the item collapsed to one point is
+ * invalidated.
+ * @param step Grid step
+ * @param isLine The item is a line or multiline, not a point or multipoint
+ */
+void VectorTileItem::snapToGrid(double step, bool isLine)
+{
+    if(m_points.empty() || step <= 0.0) {
+        return;
+    }
+
+    for(auto& point : m_points) {
+        point.x = static_cast<float>(std::round(point.x / step) * step);
+        point.y = static_cast<float>(std::round(point.y / step) * step);
+    }
+    for(auto& centroid : m_centroids) {
+        centroid.x = static_cast<float>(std::round(centroid.x / step) * step);
+        centroid.y = static_cast<float>(std::round(centroid.y / step) * step);
+    }
+
+    if(m_indices.empty()) {
+        m_points.erase(std::unique(m_points.begin(), m_points.end()),
+                       m_points.end());
+        if(isLine && m_points.size() < 2) {
+            m_valid = false;
+        }
     }
     else {
-        for(auto id : other) {
-            if(m_ids.find(id) != m_ids.end()) {
-                return true;
-            }
+        const SimplePoint& first = m_points.front();
+        if(std::all_of(m_points.begin(), m_points.end(),
+                       [&first](const SimplePoint& pt) { return pt == first; })) {
+            m_valid = false;
         }
-//        result = std::search(other.begin(), other.end(),
-//                           m_ids.begin(), m_ids.end()) != other.end();
     }
-
-    return false;
 }
-std::set<GIntBig> VectorTileItem::idsIntesect(const std::set<GIntBig> &other) const
+
+/**
+ * @brief VectorTileItem::hash Geometry hash consistent with operator==. Points
+ * compare with epsilon, which is less than float precision for values greater
+ * than 2, so only such coordinates are hashed.
+ * @return Hash value
+ */
+size_t VectorTileItem::hash() const
 {
-    std::set<GIntBig> common_data;
-    if(other.empty())
-        return common_data;
-    std::set_intersection(other.begin(), other.end(),
-                          m_ids.begin(), m_ids.end(),
-                          std::inserter(common_data, common_data.begin()));
-    return common_data;
-}
+    // FNV-1a
+    GUIntBig out = 14695981039346656037ULL;
+    auto mix = [&out](GUInt32 value) {
+        out ^= value;
+        out *= 1099511628211ULL;
+    };
 
+    mix(static_cast<GUInt32>(m_points.size()));
+    for(const auto& point : m_points) {
+        for(float value : {point.x, point.y}) {
+            GUInt32 bits = 0;
+            if(fabsf(value) > 2.0f) {
+                std::memcpy(&bits, &value, sizeof(float));
+            }
+            mix(bits);
+        }
+    }
+    return static_cast<size_t>(out);
+}
 
 //------------------------------------------------------------------------------
 // VectorTile
 //------------------------------------------------------------------------------
 
+/**
+ * @brief inflateTileBody Inflates the compressed tile body following the
+ * buffer position. The body size is read from the tile data, so it is checked
+ * before allocation.
+ * @param buffer Buffer positioned on the body size
+ * @return New buffer with the body or nullptr on error
+ */
+static Buffer* inflateTileBody(Buffer& buffer)
+{
+    size_t bodySize = buffer.getULong();
+    if(buffer.position() > static_cast<size_t>(buffer.size())) {
+        return nullptr;
+    }
+    size_t compressedSize = static_cast<size_t>(buffer.size()) -
+            buffer.position();
+    if(bodySize == 0 || bodySize > VECTOR_TILE_MAX_SIZE ||
+            bodySize > compressedSize * DEFLATE_MAX_RATIO) {
+        CPLDebug("ngstore", "Invalid vector tile body size %ld",
+                 static_cast<long>(bodySize));
+        return nullptr;
+    }
+
+    GByte* data = static_cast<GByte*>(VSIMalloc(bodySize));
+    if(nullptr == data) {
+        return nullptr;
+    }
+    size_t outSize = 0;
+    if(CPLZLibInflate(buffer.data() + buffer.position(), compressedSize,
+                      data, bodySize, &outSize) == nullptr) {
+        CPLFree(data);
+        return nullptr;
+    }
+    return new Buffer(data, static_cast<int>(outSize));
+}
+
 void VectorTile::add(const VectorTileItem &item, bool checkDuplicates)
 {
     if(!item.isValid()) {
         return;
     }
     if(checkDuplicates) {
-        auto it = std::find(m_items.begin(), m_items.end(), item);
-        if(it == m_items.end()) {
+        updateHashIndex();
+
+        // Merge to the first equal item as the linear search did
+        size_t hash = item.hash();
+        size_t found = m_items.size();
+        auto range = m_hashIndex.equal_range(hash);
+        for(auto it = range.first; it != range.second; ++it) {
+            if(it->second < found && m_items[it->second] == item) {
+                found = it->second;
+            }
+        }
+
+        if(found == m_items.size()) {
             m_items.push_back(item);
+            m_hashIndex.insert(std::make_pair(hash, found));
+            m_hashIndexSize = m_items.size();
         }
         else {
-            (*it).loadIds(item);
+            m_items[found].loadIds(item);
         }
     }
     else {
         m_items.push_back(item);
     }
+    m_idIndexValid = false;
 
     if(!m_valid) {
         m_valid = !m_items.empty();
@@ -261,16 +600,65 @@ void VectorTile::add(const VectorTileItemArray& items, bool checkDuplicates)
 
 void VectorTile::remove(GIntBig id)
 {
-    auto it = m_items.begin();
-    while(it != m_items.end()) {
-        (*it).removeId(id);
-        if((*it).isValid() == false) {
-            it = m_items.erase(it);
+    remove(FeatureIDs({id}));
+}
+
+void VectorTile::remove(const FeatureIDs& ids)
+{
+    updateIdIndex();
+
+    // Only items with removed IDs are touched
+    bool erase = false;
+    for(GIntBig id : ids) {
+        auto it = m_idIndex.find(id);
+        if(it == m_idIndex.end()) {
+            continue;
         }
-        else {
-            ++it;
+        for(size_t index : it->second) {
+            m_items[index].removeId(id);
+            if(!m_items[index].isValid()) {
+                erase = true;
+            }
         }
+        m_idIndex.erase(it);
     }
+
+    if(!erase) {
+        return;
+    }
+
+    m_items.erase(std::remove_if(m_items.begin(), m_items.end(),
+                                 [](const VectorTileItem& item) {
+                                     return !item.isValid();
+                                 }), m_items.end());
+
+    // Item indices are shifted
+    m_hashIndex.clear();
+    m_hashIndexSize = 0;
+    m_idIndexValid = false;
+}
+
+void VectorTile::updateIdIndex()
+{
+    if(m_idIndexValid) {
+        return;
+    }
+
+    m_idIndex.clear();
+    for(size_t i = 0; i < m_items.size(); ++i) {
+        for(GIntBig id : m_items[i].m_ids) {
+            m_idIndex[id].push_back(i);
+        }
+    }
+    m_idIndexValid = true;
+}
+
+void VectorTile::updateHashIndex()
+{
+    for(size_t i = m_hashIndexSize; i < m_items.size(); ++i) {
+        m_hashIndex.insert(std::make_pair(m_items[i].hash(), i));
+    }
+    m_hashIndexSize = m_items.size();
 }
 
 BufferPtr VectorTile::save()
@@ -283,15 +671,99 @@ BufferPtr VectorTile::save()
     return buff;
 }
 
+BufferPtr VectorTile::save(const Envelope& extent, bool compress)
+{
+    if(!extent.isInit()) {
+        return save();
+    }
+
+    OGRRawPoint origin(extent.minX(), extent.minY());
+    double quantum = std::max(extent.width(), extent.height()) /
+            VECTOR_TILE_EXTENT;
+
+    Buffer body;
+    body.put(origin.x);
+    body.put(origin.y);
+    body.put(quantum);
+    body.putVarUInt(m_items.size());
+    for(auto& item : m_items) {
+        item.save(&body, origin, quantum);
+    }
+
+    BufferPtr buff(new Buffer);
+    buff->put(VECTOR_TILE_V2_MAGIC);
+    if(compress) {
+        size_t bodySize = static_cast<size_t>(body.size());
+        size_t maxSize = bodySize + bodySize / 100 + 64;
+        GByte* compressed = static_cast<GByte*>(CPLMalloc(maxSize));
+        size_t compressedSize = 0;
+        if(CPLZLibDeflate(body.data(), bodySize, -1, compressed, maxSize,
+                          &compressedSize) != nullptr) {
+            buff->put(VECTOR_TILE_DEFLATE);
+            buff->put(static_cast<GUInt32>(bodySize));
+            buff->put(compressed, compressedSize);
+            CPLFree(compressed);
+            return buff;
+        }
+        CPLFree(compressed);
+    }
+
+    buff->put(static_cast<GByte>(0));
+    buff->put(body.data(), static_cast<size_t>(body.size()));
+    return buff;
+}
+
 bool VectorTile::load(Buffer& buffer)
 {
-    GUInt32 size = buffer.getULong();
-    for(GUInt32 i = 0; i < size; ++i) {
+    size_t start = buffer.position();
+    if(buffer.getULong() != VECTOR_TILE_V2_MAGIC) {
+        // v1 format
+        buffer.seek(start);
+        GUInt32 size = buffer.getULong();
+        if(!checkCount(buffer, size, VECTOR_TILE_ITEM_MIN_SIZE)) {
+            return false;
+        }
+        for(GUInt32 i = 0; i < size; ++i) {
+            VectorTileItem item;
+            if(!item.load(buffer)) {
+                return false;
+            }
+            m_items.push_back(item);
+        }
+        m_valid = true;
+        m_idIndexValid = false;
+        return true;
+    }
+
+    GByte flags = buffer.getByte();
+    Buffer* body = &buffer;
+    std::unique_ptr<Buffer> inflated;
+    if(flags & VECTOR_TILE_DEFLATE) {
+        inflated.reset(inflateTileBody(buffer));
+        if(!inflated) {
+            return false;
+        }
+        body = inflated.get();
+    }
+
+    OGRRawPoint origin;
+    origin.x = body->getDouble();
+    origin.y = body->getDouble();
+    double quantum = body->getDouble();
+    GUIntBig size = body->getVarUInt();
+    if(!checkCount(*body, size, VECTOR_TILE_V2_ITEM_MIN_SIZE)) {
+        return false;
+    }
+    m_items.reserve(m_items.size() + static_cast<size_t>(size));
+    for(GUIntBig i = 0; i < size; ++i) {
         VectorTileItem item;
-        item.load(buffer);
+        if(!item.load(*body, origin, quantum)) {
+            return false;
+        }
         m_items.push_back(item);
     }
     m_valid = true;
+    m_idIndexValid = false;
     return true;
 }
 
@@ -307,6 +779,349 @@ bool VectorTile::empty() const
     return true;
 }
 
+//------------------------------------------------------------------------------
+// VectorTileItemView
+//------------------------------------------------------------------------------
+
+VectorTileItemView::VectorTileItemView() :
+    m_points(nullptr),
+    m_pointCount(0),
+    m_indices(nullptr),
+    m_indexCount(0),
+    m_borders(nullptr),
+    m_borderCount(0),
+    m_ids(nullptr),
+    m_idCount(0)
+{
+
+}
+
+SimplePoint VectorTileItemView::point(size_t index) const
+{
+    SimplePoint pt;
+    std::memcpy(&pt, m_points + index * sizeof(SimplePoint), sizeof(SimplePoint));
+    return pt;
+}
+
+bool VectorTileItemView::isClosed() const
+{
+    if(m_pointCount == 0) {
+        return false;
+    }
+    return point(0) == point(m_pointCount - 1);
+}
+
+unsigned short VectorTileItemView::index(size_t index) const
+{
+    unsigned short val;
+    std::memcpy(&val, m_indices + index * sizeof(unsigned short),
+                sizeof(unsigned short));
+    return val;
+}
+
+size_t VectorTileItemView::borderSize(size_t ring) const
+{
+    return m_borders[ring].size;
+}
+
+unsigned short VectorTileItemView::borderIndex(size_t ring, size_t index) const
+{
+    unsigned short val;
+    std::memcpy(&val, m_borders[ring].data + index * sizeof(unsigned short),
+                sizeof(unsigned short));
+    return val;
+}
+
+GIntBig VectorTileItemView::id(size_t index) const
+{
+    GIntBig val;
+    std::memcpy(&val, m_ids + index * sizeof(GIntBig), sizeof(GIntBig));
+    return val;
+}
+
+bool VectorTileItemView::isIdsPresent(const FeatureIDs &other,
+                                      bool full) const
+{
+    if(other.empty() || (full && m_idCount > other.size())) {
+        return false;
+    }
+
+    // Tile IDs are sorted, so this is a linear merge with the other set
+    FeatureIDs::const_iterator it = other.begin();
+    for(size_t i = 0; i < m_idCount; ++i) {
+        GIntBig value = id(i);
+        it = std::lower_bound(it, other.end(), value);
+        bool found = it != other.end() && *it == value;
+        if(full && !found) {
+            return false;
+        }
+        if(!full && found) {
+            return true;
+        }
+        if(it == other.end() && !full) {
+            return false;
+        }
+    }
+    return full;
+}
+
+//------------------------------------------------------------------------------
+// VectorTileView
+//------------------------------------------------------------------------------
+
+static bool skipBytes(Buffer& buffer, size_t count)
+{
+    size_t position = buffer.position() + count;
+    if(position > static_cast<size_t>(buffer.size())) {
+        return false;
+    }
+    buffer.seek(position);
+    return true;
+}
+
+VectorTileView::VectorTileView() :
+    m_start(0),
+    m_count(0),
+    m_current(0),
+    m_v2(false),
+    m_quantum(1.0)
+{
+
+}
+
+bool VectorTileView::load(const GByte* data, size_t size)
+{
+    GByte* copy = static_cast<GByte*>(CPLMalloc(size));
+    std::memcpy(copy, data, size);
+    return load(BufferPtr(new Buffer(copy, static_cast<int>(size))));
+}
+
+bool VectorTileView::load(const BufferPtr& buffer)
+{
+    m_buffer = buffer;
+    m_buffer->seek(0);
+    m_v2 = m_buffer->getULong() == VECTOR_TILE_V2_MAGIC;
+    if(!m_v2) {
+        m_buffer->seek(0);
+        m_count = m_buffer->getULong();
+        if(!checkCount(*m_buffer, m_count, VECTOR_TILE_ITEM_MIN_SIZE)) {
+            m_buffer.reset();
+            return false;
+        }
+        m_start = m_buffer->position();
+        m_current = 0;
+        return true;
+    }
+
+    GByte flags = m_buffer->getByte();
+    if(flags & VECTOR_TILE_DEFLATE) {
+        Buffer* inflated = inflateTileBody(*m_buffer);
+        m_buffer.reset(inflated);
+        if(nullptr == inflated) {
+            return false;
+        }
+    }
+
+    m_origin.x = m_buffer->getDouble();
+    m_origin.y = m_buffer->getDouble();
+    m_quantum = m_buffer->getDouble();
+    m_count = m_buffer->getVarUInt();
+    if(!checkCount(*m_buffer, m_count, VECTOR_TILE_V2_ITEM_MIN_SIZE)) {
+        m_buffer.reset();
+        return false;
+    }
+    m_start = m_buffer->position();
+    m_current = 0;
+    return true;
+}
+
+void VectorTileView::reset()
+{
+    if(m_buffer) {
+        m_buffer->seek(m_start);
+    }
+    m_current = 0;
+}
+
+bool VectorTileView::next(VectorTileItemView& item)
+{
+    if(!m_buffer || m_current >= m_count) {
+        return false;
+    }
+    m_current++;
+    if(!(m_v2 ? nextV2(item) : nextV1(item))) {
+        // Rest of corrupted tile is not readable
+        m_current = m_count;
+        return false;
+    }
+    return true;
+}
+
+bool VectorTileView::empty()
+{
+    reset();
+    VectorTileItemView item;
+    bool out = true;
+    while(next(item)) {
+        if(item.pointCount() > 0) {
+            out = false;
+            break;
+        }
+    }
+    reset();
+    return out;
+}
+
+bool VectorTileView::nextV1(VectorTileItemView& item)
+{
+    Buffer& buffer = *m_buffer;
+    bool is2d = buffer.getByte() != 0;
+
+    // vector<SimplePoint> m_points. 3D points are not stored yet.
+    GUInt32 size = buffer.getULong();
+    item.m_points = buffer.data() + buffer.position();
+    item.m_pointCount = is2d ? size : 0;
+    if(!skipBytes(buffer, item.m_pointCount * sizeof(SimplePoint))) {
+        return false;
+    }
+
+    // vector<unsigned short> m_indices
+    item.m_indexCount = buffer.getULong();
+    item.m_indices = buffer.data() + buffer.position();
+    if(!skipBytes(buffer, item.m_indexCount * sizeof(unsigned short))) {
+        return false;
+    }
+
+    //vector<vector<unsigned short>> m_borderIndices
+    m_borders.clear();
+    size = buffer.getULong();
+    if(!checkCount(buffer, size, sizeof(GUInt32))) {
+        return false;
+    }
+    for(GUInt32 i = 0; i < size; ++i) {
+        VectorTileItemView::BorderRing ring;
+        ring.size = buffer.getULong();
+        ring.data = buffer.data() + buffer.position();
+        if(!skipBytes(buffer, ring.size * sizeof(unsigned short))) {
+            return false;
+        }
+        if(ring.size > 0) {
+            m_borders.push_back(ring);
+        }
+    }
+    item.m_borders = m_borders.data();
+    item.m_borderCount = m_borders.size();
+
+    // vector<SimplePoint> m_centroids
+    size = buffer.getULong();
+    if(is2d && !skipBytes(buffer, size * sizeof(SimplePoint))) {
+        return false;
+    }
+
+    // FeatureIDs m_ids
+    item.m_idCount = buffer.getULong();
+    item.m_ids = buffer.data() + buffer.position();
+    return skipBytes(buffer, item.m_idCount * sizeof(GIntBig));
+}
+
+bool VectorTileView::nextV2(VectorTileItemView& item)
+{
+    Buffer& buffer = *m_buffer;
+    bool is2d = buffer.getByte() != 0;
+
+    // vector<SimplePoint> m_points
+    m_points.clear();
+    GIntBig x = 0, y = 0;
+    GUIntBig size = buffer.getVarUInt();
+    if(!checkCount(buffer, is2d ? size : 0, 2)) {
+        return false;
+    }
+    for(GUIntBig i = 0; i < size && is2d; ++i) {
+        x += buffer.getVarInt();
+        y += buffer.getVarInt();
+        SimplePoint pt = {static_cast<float>(m_origin.x + x * m_quantum),
+                          static_cast<float>(m_origin.y + y * m_quantum)};
+        m_points.push_back(pt);
+    }
+
+    // vector<unsigned short> m_indices
+    m_indices.clear();
+    GIntBig index = 0;
+    size = buffer.getVarUInt();
+    if(!checkCount(buffer, size, 1)) {
+        return false;
+    }
+    for(GUIntBig i = 0; i < size; ++i) {
+        index += buffer.getVarInt();
+        m_indices.push_back(static_cast<unsigned short>(index));
+    }
+
+    //vector<vector<unsigned short>> m_borderIndices
+    m_borderIndices.clear();
+    m_borderSizes.clear();
+    size = buffer.getVarUInt();
+    if(!checkCount(buffer, size, 1)) {
+        return false;
+    }
+    for(GUIntBig i = 0; i < size; ++i) {
+        index = 0;
+        GUIntBig size1 = buffer.getVarUInt();
+        if(!checkCount(buffer, size1, 1)) {
+            return false;
+        }
+        for(GUIntBig j = 0; j < size1; ++j) {
+            index += buffer.getVarInt();
+            m_borderIndices.push_back(static_cast<unsigned short>(index));
+        }
+        if(size1 > 0) {
+            m_borderSizes.push_back(static_cast<size_t>(size1));
+        }
+    }
+
+    // Ring pointers are set after decoding as the array may be reallocated.
+    m_borders.clear();
+    const unsigned short* ringData = m_borderIndices.data();
+    for(size_t ringSize : m_borderSizes) {
+        VectorTileItemView::BorderRing ring;
+        ring.data = reinterpret_cast<const GByte*>(ringData);
+        ring.size = ringSize;
+        m_borders.push_back(ring);
+        ringData += ringSize;
+    }
+
+    // vector<SimplePoint> m_centroids
+    size = buffer.getVarUInt();
+    if(!checkCount(buffer, is2d ? size : 0, 2)) {
+        return false;
+    }
+    for(GUIntBig i = 0; i < size && is2d; ++i) {
+        buffer.getVarInt();
+        buffer.getVarInt();
+    }
+
+    // FeatureIDs m_ids
+    m_ids.clear();
+    GIntBig id = 0;
+    size = buffer.getVarUInt();
+    if(!checkCount(buffer, size, 1)) {
+        return false;
+    }
+    for(GUIntBig i = 0; i < size; ++i) {
+        id += buffer.getVarInt();
+        m_ids.push_back(id);
+    }
+
+    item.m_points = reinterpret_cast<const GByte*>(m_points.data());
+    item.m_pointCount = m_points.size();
+    item.m_indices = reinterpret_cast<const GByte*>(m_indices.data());
+    item.m_indexCount = m_indices.size();
+    item.m_borders = m_borders.data();
+    item.m_borderCount = m_borders.size();
+    item.m_ids = reinterpret_cast<const GByte*>(m_ids.data());
+    item.m_idCount = m_ids.size();
+    return buffer.position() <= static_cast<size_t>(buffer.size());
+}
+
 //------------------------------------------------------------------------------
 // Envelope
 //------------------------------------------------------------------------------
@@ -570,6 +1385,17 @@ Normal ngsGetNormals(const SimplePoint &beg, const SimplePoint &end)
     return {normX, normY};
 }
 
+//------------------------------------------------------------------------------
+// GEOSContextHandlePtr
+//------------------------------------------------------------------------------
+GEOSContextHandlePtr GEOSContextHandlePtr::threadContext()
+{
+    // NOTE: Executor workers are persistent, so each worker creates the
+    // context once.
+    static thread_local GEOSContextHandlePtr handle;
+    return handle;
+}
+
 //------------------------------------------------------------------------------
 // GEOSGeometryWrap
 //------------------------------------------------------------------------------
@@ -579,7 +1405,10 @@ GEOSGeometryWrap::GEOSGeometryWrap(GEOSGeom geom, GEOSContextHandlePtr handle) :
 {
 }
 
-GEOSGeometryWrap::GEOSGeometryWrap(OGRGeometry* geom) : m_geom(nullptr)
+GEOSGeometryWrap::GEOSGeometryWrap(OGRGeometry* geom, bool ownContext) :
+    m_geom(nullptr),
+    m_geosHandle(ownContext ? GEOSContextHandlePtr() :
+                              GEOSContextHandlePtr::threadContext())
 {
     if(nullptr != geom) {
         m_geom = geom->exportToGEOS(m_geosHandle.get());
@@ -604,11 +1433,103 @@ GEOSGeometryPtr GEOSGeometryWrap::clip(const Envelope& env) const
     return GEOSGeometryPtr(new GEOSGeometryWrap(clipped, m_geosHandle));
 }
 
+static double snapValue(double value, double step)
+{
+    return static_cast<long>(value / step) * step;
+}
+
 static OGRRawPoint generalize(double x, double y, double step)
 {
     OGRRawPoint out;
-    out.x = static_cast<long>(x / step) * step;
-    out.y = static_cast<long>(y / step) * step;
+    out.x = snapValue(x, step);
+    out.y = snapValue(y, step);
+    return out;
+}
+
+static void snapValues(double* values, size_t size, double step)
+{
+    size_t i = 0;
+#if defined(NGS_SNAP_SSE2)
+    // SSE2 truncates to 32 bit integers only. The pairs out of this range are
+    // snapped by the scalar code.
+    const __m128d stepV = _mm_set1_pd(step);
+    const __m128d limitV = _mm_set1_pd(2147483647.0);
+    const __m128d signV = _mm_set1_pd(-0.0);
+    for(; i + 2 <= size; i += 2) {
+        __m128d v = _mm_div_pd(_mm_loadu_pd(values + i), stepV);
+        if(_mm_movemask_pd(_mm_cmplt_pd(_mm_andnot_pd(signV, v), limitV)) != 3) {
+            values[i] = snapValue(values[i], step);
+            values[i + 1] = snapValue(values[i + 1], step);
+            continue;
+        }
+        __m128d t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(v));
+        _mm_storeu_pd(values + i, _mm_mul_pd(t, stepV));
+    }
+#elif defined(NGS_SNAP_NEON)
+    const float64x2_t stepV = vdupq_n_f64(step);
+    for(; i + 2 <= size; i += 2) {
+        float64x2_t v = vdivq_f64(vld1q_f64(values + i), stepV);
+        float64x2_t t = vcvtq_f64_s64(vcvtq_s64_f64(v));
+        vst1q_f64(values + i, vmulq_f64(t, stepV));
+    }
+#endif
+    for(; i < size; ++i) {
+        values[i] = snapValue(values[i], step);
+    }
+}
+
+/**
+ * @brief The GridPoint struct Point key for hash containers. The bitwise
+ * comparison is used, which is exact for the snapped coordinates (they are
+ * multiples of the step) and for the points copied from the same source.
+ */
+typedef struct _gridPoint {
+    double x, y;
+    bool operator==(const struct _gridPoint& other) const {
+        return x == other.x && y == other.y;
+    }
+} GridPoint;
+
+struct GridPointHash {
+    size_t operator()(const GridPoint& pt) const {
+        // Add zero to map -0.0 to 0.0
+        double x = pt.x + 0.0, y = pt.y + 0.0;
+        GUIntBig xBits, yBits;
+        std::memcpy(&xBits, &x, sizeof(GUIntBig));
+        std::memcpy(&yBits, &y, sizeof(GUIntBig));
+        GUIntBig hash = xBits * 0x9E3779B97F4A7C15ULL;
+        hash ^= yBits + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+        return static_cast<size_t>(hash);
+    }
+};
+
+size_t generalizeCoordinates(double* coords, size_t count, double step,
+                             bool isRing)
+{
+    snapValues(coords, count * 2, step);
+
+    std::unordered_set<GridPoint, GridPointHash> ringPoints;
+    if(isRing) {
+        ringPoints.reserve(count);
+    }
+
+    size_t out = 0;
+    for(size_t i = 0; i < count; ++i) {
+        double x = coords[i * 2];
+        double y = coords[i * 2 + 1];
+        if(out > 0 && isEqual(coords[out * 2 - 2], x) &&
+                isEqual(coords[out * 2 - 1], y)) {
+            continue;
+        }
+
+        if(isRing && !ringPoints.insert({x, y}).second) {
+            continue;
+        }
+
+        coords[out * 2] = x;
+        coords[out * 2 + 1] = y;
+        ++out;
+    }
     return out;
 }
 
@@ -681,56 +1602,46 @@ GEOSGeom GEOSGeometryWrap::generalizeLine(const GEOSGeom_t* geom, double step,
     unsigned int count = 0;
     GEOSCoordSeq_getSize_r(m_geosHandle.get(), cs, &count);
 
-    OGRRawPoint prevGpoint(BIG_VALUE, BIG_VALUE);
-    double x, y;
-    std::vector<OGRRawPoint> parts;
-    struct OGRRawPointIs {
-        OGRRawPointIs( OGRRawPoint s ) : toFind(s) { }
-        bool operator() (const OGRRawPoint &n) {
-            return isEqual(n.x, toFind.x) && isEqual(n.y, toFind.y);
-        }
-        OGRRawPoint toFind;
-    };
-
+    // Copy coordinates to contiguous buffer with a place for ring closing point
+    std::vector<double> coords((count + 1) * 2);
+#if GEOS_VERSION_MAJOR > 3 || (GEOS_VERSION_MAJOR == 3 && GEOS_VERSION_MINOR >= 10)
+    GEOSCoordSeq_copyToBuffer_r(m_geosHandle.get(), cs, coords.data(), 0, 0);
+#else
     for(unsigned int i = 0; i < count; ++i) {
-        GEOSCoordSeq_getX_r(m_geosHandle.get(), cs, i, &x);
-        GEOSCoordSeq_getY_r(m_geosHandle.get(), cs, i, &y);
-        OGRRawPoint gpoint = generalize(x, y, step);
-
-        if(isRing && std::find_if(parts.begin(), parts.end(),
-                                  OGRRawPointIs(gpoint)) != parts.end()) {
-            continue;
-        }
-
-        if(isEqual(prevGpoint.x, gpoint.x) && isEqual(prevGpoint.y, gpoint.y)) {
-            continue;
-        }
-
-        parts.push_back(gpoint);
-        prevGpoint = gpoint;
+        GEOSCoordSeq_getX_r(m_geosHandle.get(), cs, i, &coords[i * 2]);
+        GEOSCoordSeq_getY_r(m_geosHandle.get(), cs, i, &coords[i * 2 + 1]);
     }
+#endif
 
-    if(parts.size() < 2) {
+    size_t size = generalizeCoordinates(coords.data(), count, step, isRing);
+    if(size < 2) {
         return nullptr;
     }
 
     if(isRing) {
-        if(parts.size() < 3) {
+        if(size < 3) {
             return nullptr;
         }
-        parts.push_back(parts.front());
-    }
-
+        coords[size * 2] = coords[0];
+        coords[size * 2 + 1] = coords[1];
+        size++;
+    }
+
+    CPLDebug("ngstore", "parts - %ld", static_cast<long>(size));
+#if GEOS_VERSION_MAJOR > 3 || (GEOS_VERSION_MAJOR == 3 && GEOS_VERSION_MINOR >= 10)
+    GEOSCoordSeq ncs = GEOSCoordSeq_copyFromBuffer_r(m_geosHandle.get(),
+                                                     coords.data(),
+                                                     static_cast<unsigned int>(size),
+                                                     0, 0);
+#else
     GEOSCoordSeq ncs = GEOSCoordSeq_create_r(m_geosHandle.get(),
-                                             static_cast<unsigned int>(parts.size()),
+                                             static_cast<unsigned int>(size),
                                              2);
-    unsigned int counter = 0;
-    CPLDebug("ngstore", "parts - %ld", parts.size());
-    for(const OGRRawPoint& pt : parts) {
-        GEOSCoordSeq_setX_r(m_geosHandle.get(), ncs, counter, pt.x);
-        GEOSCoordSeq_setY_r(m_geosHandle.get(), ncs, counter, pt.y);
-        counter++;
+    for(unsigned int i = 0; i < size; ++i) {
+        GEOSCoordSeq_setX_r(m_geosHandle.get(), ncs, i, coords[i * 2]);
+        GEOSCoordSeq_setY_r(m_geosHandle.get(), ncs, i, coords[i * 2 + 1]);
     }
+#endif
 
     if(isRing) {
         return GEOSGeom_createLinearRing_r(m_geosHandle.get(), ncs);
@@ -1001,16 +1912,32 @@ typedef struct _edgePt {
 
 typedef std::map<int, std::vector<EDGE_PT>> EDGES;
 
-void setEdgeIndex(unsigned short index, double x, double y, EDGES& edges)
+/**
+ * @brief edgePointsByVertex Maps polygon vertex index (continuous numbering
+ * through all rings as the ear cut uses) to the first ring point with the same
+ * coordinates.
+ * @param edges Polygon rings
+ * @return Array of ring point pointers
+ */
+static std::vector<EDGE_PT*> edgePointsByVertex(EDGES& edges)
 {
+    size_t count = 0;
+    for(const auto& edge : edges) {
+        count += edge.second.size();
+    }
+
+    std::vector<EDGE_PT*> out;
+    out.reserve(count);
+    std::unordered_map<GridPoint, EDGE_PT*, GridPointHash> firstPoints;
+    firstPoints.reserve(count);
     for(auto& edge : edges) {
         for(EDGE_PT& edgeitem : edge.second) {
-            if(isEqual(edgeitem.pr.x, x) && isEqual(edgeitem.pr.y, y)) {
-                edgeitem.index = index;
-                return;
-            }
+            GridPoint key = {edgeitem.pr.x, edgeitem.pr.y};
+            auto result = firstPoints.insert(std::make_pair(key, &edgeitem));
+            out.push_back(result.first->second);
         }
     }
+    return out;
 }
 
 // The number type to use for tessellation
@@ -1025,21 +1952,6 @@ typedef std::array<Coord, 2> MBPoint;
 typedef std::vector<MBPoint> MBVertices;
 typedef std::vector<MBVertices> MBPolygon;
 
-OGRRawPoint findPointByIndex(N index, const MBPolygon& poly)
-{
-    N currentIndex = index;
-    for(const auto& vertices : poly) {
-        if(currentIndex >= vertices.size()) {
-            currentIndex -= vertices.size();
-            continue;
-        }
-
-        MBPoint pt = vertices[currentIndex];
-        return OGRRawPoint(pt[0], pt[1]);
-    }
-    return OGRRawPoint(BIG_VALUE, BIG_VALUE);
-}
-
 void GEOSGeometryWrap::fillPolygonTile(GIntBig fid, const GEOSGeom_t* geom,
                                        VectorTileItemArray& vitemArray)
 {
@@ -1156,22 +2068,28 @@ void GEOSGeometryWrap::fillPolygonTile(GIntBig fid, const GEOSGeom_t* geom,
     }
 
     unsigned char tinIndex = 0;
-    OGRRawPoint tin[3];
+    EDGE_PT* tin[3];
     unsigned short vertexIndex = 0;
+    std::vector<EDGE_PT*> vertexEdges = edgePointsByVertex(edges);
 
     for(auto index : indices) {
-        tin[tinIndex] = findPointByIndex(index, polygon);
+        tin[tinIndex] = index < vertexEdges.size() ? vertexEdges[index] :
+                                                     nullptr;
         tinIndex++;
 
         if(tinIndex == 3) {
             tinIndex = 0;
 
             for(unsigned char j = 0; j < 3; ++j) {
-                SimplePoint pt = { static_cast<float>(tin[j].x),
-                                   static_cast<float>(tin[j].y) };
+                OGRRawPoint rawPt = tin[j] ? tin[j]->pr :
+                                             OGRRawPoint(BIG_VALUE, BIG_VALUE);
+                SimplePoint pt = { static_cast<float>(rawPt.x),
+                                   static_cast<float>(rawPt.y) };
                 vitem.addPoint(pt);
-                // Check each vertex belongs to exterior or interior ring
-                setEdgeIndex(vertexIndex, tin[j].x, tin[j].y, edges);
+                // Mark the exterior or interior ring point of each vertex
+                if(tin[j]) {
+                    tin[j]->index = vertexIndex;
+                }
 
                 vitem.addIndex(vertexIndex++);
             }
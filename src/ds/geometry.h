@@ -28,10 +28,12 @@
 #include <array>
 #include <memory>
 #include <set>
+#include <unordered_map>
 
 #include "api_priv.h"
 #include "ngstore/util/constants.h"
 #include "util/buffer.h"
+#include "util/featureids.h"
 
 namespace ngs {
 
@@ -172,33 +174,45 @@ public:
     bool operator==(const VectorTileItem& other) const {
         return m_points == other.m_points;
     }
-    bool isIdsPresent(const std::set<GIntBig> &other, bool full = true) const;
-    std::set<GIntBig> idsIntesect(const std::set<GIntBig> &other) const;
+    bool isIdsPresent(const FeatureIDs &other, bool full = true) const;
+    FeatureIDs idsIntesect(const FeatureIDs &other) const;
+    size_t memorySize() const;
+    void snapToGrid(double step, bool isLine);
+    size_t hash() const;
 
 protected:
     void loadIds(const VectorTileItem& item);
     void save(Buffer* buffer);
     bool load(Buffer& buffer);
+    void save(Buffer* buffer, const OGRRawPoint& origin, double quantum);
+    bool load(Buffer& buffer, const OGRRawPoint& origin, double quantum);
 private:
     std::vector<SimplePoint> m_points;
     std::vector<unsigned short> m_indices;
     std::vector<std::vector<unsigned short>> m_borderIndices; // NOTE: first array is exterior ring indices
     std::vector<SimplePoint> m_centroids;
-    std::set<GIntBig> m_ids;
+    FeatureIDs m_ids;
     bool m_valid;
     bool m_2d;
 };
 
 typedef std::vector<VectorTileItem> VectorTileItemArray;
 
+/**
+ * @brief The VectorTile class Overview tile items. Stored in v1 format (raw
+ * floats) or compact v2 format (quantized to tile extent, delta and varint
+ * encoded, optionally deflated). Both formats are readable.
+ */
 class VectorTile
 {
 public:
-    VectorTile() : m_valid(false) {}
+    VectorTile() : m_valid(false), m_hashIndexSize(0), m_idIndexValid(false) {}
     void add(const VectorTileItem &item, bool checkDuplicates = false);
     void add(const VectorTileItemArray& items, bool checkDuplicates = false);
     void remove(GIntBig id);
+    void remove(const FeatureIDs& ids);
     BufferPtr save();
+    BufferPtr save(const Envelope& extent, bool compress = false);
     bool load(Buffer& buffer);
     VectorTileItemArray items() const {
         return m_items;
@@ -206,16 +220,122 @@ public:
     bool empty() const;
 
     bool isValid() const { return m_valid; }
+
+private:
+    void updateHashIndex();
+    void updateIdIndex();
+
 private:
     VectorTileItemArray m_items;
     bool m_valid;
+    // Item geometry hash to item index. Used to find duplicates.
+    std::unordered_multimap<size_t, size_t> m_hashIndex;
+    size_t m_hashIndexSize;
+    // Feature ID to indices of items with this ID. Built on first remove.
+    std::unordered_map<GIntBig, std::vector<size_t>> m_idIndex;
+    bool m_idIndexValid;
+};
+
+/**
+ * @brief The VectorTileItemView class Read only item of VectorTileView. Holds
+ * pointers to the tile bytes (v1 format) or to the view decode arrays (v2
+ * format), so it is valid only until the next VectorTileView::next call.
+ */
+class VectorTileItemView
+{
+    friend class VectorTileView;
+public:
+    VectorTileItemView();
+    size_t pointCount() const { return m_pointCount; }
+    SimplePoint point(size_t index) const;
+    bool isClosed() const;
+    size_t indexCount() const { return m_indexCount; }
+    unsigned short index(size_t index) const;
+    size_t borderCount() const { return m_borderCount; }
+    size_t borderSize(size_t ring) const;
+    unsigned short borderIndex(size_t ring, size_t index) const;
+    size_t idCount() const { return m_idCount; }
+    GIntBig id(size_t index) const;
+    bool isIdsPresent(const FeatureIDs &other, bool full = true) const;
+
+private:
+    typedef struct _borderRing {
+        const GByte* data;
+        size_t size;
+    } BorderRing;
+
+private:
+    const GByte* m_points;
+    size_t m_pointCount;
+    const GByte* m_indices;
+    size_t m_indexCount;
+    const BorderRing* m_borders;
+    size_t m_borderCount;
+    const GByte* m_ids;
+    size_t m_idCount;
 };
 
+/**
+ * @brief The VectorTileView class Read only sequential access to the items of
+ * saved VectorTile without unpacking them to VectorTileItem. Decode arrays
+ * are reused between items, so iterating does no per item heap allocation.
+ */
+class VectorTileView
+{
+public:
+    VectorTileView();
+    bool load(const GByte* data, size_t size);
+    bool load(const BufferPtr& buffer);
+    void reset();
+    bool next(VectorTileItemView& item);
+    bool empty();
+    bool isValid() const { return m_buffer != nullptr; }
+
+private:
+    bool nextV1(VectorTileItemView& item);
+    bool nextV2(VectorTileItemView& item);
+
+private:
+    BufferPtr m_buffer;
+    size_t m_start;
+    GUIntBig m_count;
+    GUIntBig m_current;
+    bool m_v2;
+    OGRRawPoint m_origin;
+    double m_quantum;
+    std::vector<SimplePoint> m_points;
+    std::vector<unsigned short> m_indices;
+    std::vector<unsigned short> m_borderIndices;
+    std::vector<size_t> m_borderSizes;
+    std::vector<VectorTileItemView::BorderRing> m_borders;
+    std::vector<GIntBig> m_ids;
+};
+
+/**
+ * @brief generalizeCoordinates Snaps interleaved x,y coordinates to the grid
+ * with the step and removes repeated points in place. For rings all the
+ * duplicates are removed, for lines only the consecutive ones.
+ * @param coords Interleaved x,y coordinates array
+ * @param count Point count in array
+ * @param step Grid step
+ * @param isRing If true, the coordinates are ring
+ * @return Point count left in array
+ */
+size_t generalizeCoordinates(double* coords, size_t count, double step,
+                             bool isRing = false);
+
 class GEOSContextHandlePtr : public std::shared_ptr<struct GEOSContextHandle_HS>
 {
 public:
     GEOSContextHandlePtr() : shared_ptr(OGRGeometry::createGEOSContext(),
                                         OGRGeometry::freeGEOSContext) {}
+    /**
+     * @brief threadContext Returns GEOS context of current thread. The context
+     * is created on first use and freed on thread exit (if not referenced by
+     * any geometry).
+     * @return GEOS context handle
+     */
+    static GEOSContextHandlePtr threadContext();
 };
 
 class GEOSGeometryWrap;
@@ -224,7 +344,7 @@ class GEOSGeometryWrap
 {
 public:
     explicit GEOSGeometryWrap(GEOSGeom geom, GEOSContextHandlePtr handle);
-    explicit GEOSGeometryWrap(OGRGeometry* geom);
+    explicit GEOSGeometryWrap(OGRGeometry* geom, bool ownContext = false);
     ~GEOSGeometryWrap();
     GEOSGeom geom() const { return m_geom; }
     int type() const;
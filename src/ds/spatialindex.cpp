@@ -0,0 +1,363 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2016-2017 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "spatialindex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "util/error.h"
+
+namespace ngs {
+
+constexpr GUInt32 SPATIAL_INDEX_MAGIC = 0x4953474E; // "NGSI"
+constexpr GUInt32 SPATIAL_INDEX_NODE_SIZE = 16;
+constexpr GUInt32 HILBERT_MAX = 0xFFFF;
+
+/**
+ * @brief hilbert Hilbert curve value of the point in 65536x65536 grid.
+ * Branchless algorithm from https://github.com/rawrunprotected/hilbert_curves
+ */
+static GUInt32 hilbert(GUInt32 x, GUInt32 y)
+{
+    GUInt32 a = x ^ y;
+    GUInt32 b = 0xFFFF ^ a;
+    GUInt32 c = 0xFFFF ^ (x | y);
+    GUInt32 d = x & (y ^ 0xFFFF);
+
+    GUInt32 A = a | (b >> 1);
+    GUInt32 B = (a >> 1) ^ a;
+    GUInt32 C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    GUInt32 D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+    B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+    C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+    D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+    B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+    C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+    D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+    a = A; b = B; c = C; d = D;
+    C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+    D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    GUInt32 i0 = x ^ y;
+    GUInt32 i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+
+/**
+ * @brief levelBounds Node index ranges of the tree levels. First range is
+ * leaves, last range is root.
+ */
+static std::vector<std::pair<GUIntBig, GUIntBig>> levelBounds(
+        GUIntBig itemCount, GUInt32 nodeSize, GUIntBig& nodeCount)
+{
+    std::vector<std::pair<GUIntBig, GUIntBig>> out;
+    nodeCount = 0;
+    if(itemCount == 0 || nodeSize < 2) {
+        return out;
+    }
+
+    std::vector<GUIntBig> levelNodeCount;
+    GUIntBig count = itemCount;
+    nodeCount = count;
+    levelNodeCount.push_back(count);
+    do {
+        count = (count + nodeSize - 1) / nodeSize;
+        nodeCount += count;
+        levelNodeCount.push_back(count);
+    } while(count != 1);
+
+    GUIntBig offset = nodeCount;
+    for(GUIntBig levelCount : levelNodeCount) {
+        offset -= levelCount;
+        out.push_back(std::make_pair(offset, offset + levelCount));
+    }
+    return out;
+}
+
+static void expand(SpatialIndex::Item& item, const SpatialIndex::Item& other)
+{
+    item.minX = std::min(item.minX, other.minX);
+    item.minY = std::min(item.minY, other.minY);
+    item.maxX = std::max(item.maxX, other.maxX);
+    item.maxY = std::max(item.maxY, other.maxY);
+}
+
+SpatialIndex::SpatialIndex() :
+    m_mem(nullptr),
+    m_file(nullptr),
+    m_header(nullptr),
+    m_nodes(nullptr),
+    m_nodeCount(0)
+{
+
+}
+
+SpatialIndex::~SpatialIndex()
+{
+    close();
+}
+
+bool SpatialIndex::build(std::vector<Item>& items, GIntBig sourceTime)
+{
+    close();
+
+    double minX = std::numeric_limits<double>::max();
+    double minY = std::numeric_limits<double>::max();
+    double maxX = -std::numeric_limits<double>::max();
+    double maxY = -std::numeric_limits<double>::max();
+    for(const Item& item : items) {
+        minX = std::min(minX, item.minX);
+        minY = std::min(minY, item.minY);
+        maxX = std::max(maxX, item.maxX);
+        maxY = std::max(maxY, item.maxY);
+    }
+
+    // Sort items by Hilbert value of the envelope center
+    double width = maxX - minX;
+    double height = maxY - minY;
+    std::vector<std::pair<GUInt32, size_t>> order;
+    order.reserve(items.size());
+    for(size_t i = 0; i < items.size(); ++i) {
+        const Item& item = items[i];
+        GUInt32 x = width > 0.0 ? static_cast<GUInt32>(HILBERT_MAX *
+                ((item.minX + item.maxX) * 0.5 - minX) / width) : 0;
+        GUInt32 y = height > 0.0 ? static_cast<GUInt32>(HILBERT_MAX *
+                ((item.minY + item.maxY) * 0.5 - minY) / height) : 0;
+        order.push_back(std::make_pair(hilbert(x, y), i));
+    }
+    std::sort(order.begin(), order.end());
+
+    GUIntBig nodeCount = 0;
+    auto bounds = levelBounds(items.size(), SPATIAL_INDEX_NODE_SIZE, nodeCount);
+    size_t size = sizeof(Header) + static_cast<size_t>(nodeCount) * sizeof(Item);
+    m_buffer.assign(size, 0);
+
+    Header header;
+    header.magic = SPATIAL_INDEX_MAGIC;
+    header.nodeSize = SPATIAL_INDEX_NODE_SIZE;
+    header.itemCount = items.size();
+    header.sourceTime = sourceTime;
+    std::memcpy(m_buffer.data(), &header, sizeof(Header));
+
+    Item* nodes = reinterpret_cast<Item*>(m_buffer.data() + sizeof(Header));
+    if(!bounds.empty()) {
+        Item* leaves = nodes + bounds.front().first;
+        for(size_t i = 0; i < order.size(); ++i) {
+            leaves[i] = items[order[i].second];
+        }
+
+        // Pack each level to the nodes of the upper level
+        for(size_t level = 0; level < bounds.size() - 1; ++level) {
+            GUIntBig pos = bounds[level].first;
+            GUIntBig end = bounds[level].second;
+            GUIntBig parentPos = bounds[level + 1].first;
+            while(pos < end) {
+                Item node = { std::numeric_limits<double>::max(),
+                              std::numeric_limits<double>::max(),
+                              -std::numeric_limits<double>::max(),
+                              -std::numeric_limits<double>::max(), pos };
+                for(GUInt32 j = 0; j < SPATIAL_INDEX_NODE_SIZE && pos < end;
+                    ++j) {
+                    expand(node, nodes[pos++]);
+                }
+                nodes[parentPos++] = node;
+            }
+        }
+    }
+
+    return init(m_buffer.data(), m_buffer.size());
+}
+
+bool SpatialIndex::open(const char* path)
+{
+    close();
+
+    VSIStatBufL sbuf;
+    if(VSIStatL(path, &sbuf) != 0 ||
+            static_cast<size_t>(sbuf.st_size) < sizeof(Header)) {
+        return false;
+    }
+    size_t size = static_cast<size_t>(sbuf.st_size);
+
+    m_file = VSIFOpenL(path, "rb");
+    if(nullptr == m_file) {
+        return false;
+    }
+
+    if(CPLIsVirtualMemFileMapAvailable()) {
+        m_mem = CPLVirtualMemFileMapNew(m_file, 0, size, VIRTUALMEM_READONLY,
+                                        nullptr, nullptr);
+    }
+
+    if(nullptr != m_mem) {
+        if(init(static_cast<GByte*>(CPLVirtualMemGetAddr(m_mem)), size)) {
+            return true;
+        }
+        close();
+        return false;
+    }
+
+    // Memory mapping is not available. Read whole file.
+    m_buffer.resize(size);
+    bool result = VSIFReadL(m_buffer.data(), 1, size, m_file) == size;
+    VSIFCloseL(m_file);
+    m_file = nullptr;
+    if(!result || !init(m_buffer.data(), size)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool SpatialIndex::save(const char* path) const
+{
+    if(nullptr == m_header) {
+        return false;
+    }
+
+    VSILFILE* file = VSIFOpenL(path, "wb");
+    if(nullptr == file) {
+        return errorMessage(_("Failed to create spatial index file %s"), path);
+    }
+
+    size_t size = sizeof(Header) +
+            static_cast<size_t>(m_nodeCount) * sizeof(Item);
+    bool result = VSIFWriteL(m_header, 1, size, file) == size;
+    VSIFCloseL(file);
+    if(!result) {
+        VSIUnlink(path);
+        return errorMessage(_("Failed to write spatial index file %s"), path);
+    }
+    return true;
+}
+
+std::vector<GIntBig> SpatialIndex::search(const Envelope& env) const
+{
+    std::vector<GIntBig> out;
+    if(m_levelBounds.empty()) {
+        return out;
+    }
+
+    GUIntBig leavesStart = m_levelBounds.front().first;
+    GUInt32 nodeSize = m_header->nodeSize;
+
+    // Node index and level
+    std::vector<std::pair<GUIntBig, size_t>> queue;
+    queue.push_back(std::make_pair(0, m_levelBounds.size() - 1));
+    while(!queue.empty()) {
+        GUIntBig nodeIndex = queue.back().first;
+        size_t level = queue.back().second;
+        queue.pop_back();
+
+        bool isLeaf = nodeIndex >= leavesStart;
+        GUIntBig end = std::min(nodeIndex + nodeSize,
+                                m_levelBounds[level].second);
+        for(GUIntBig pos = nodeIndex; pos < end; ++pos) {
+            const Item& item = m_nodes[pos];
+            if(env.maxX() < item.minX || env.minX() > item.maxX ||
+               env.maxY() < item.minY || env.minY() > item.maxY) {
+                continue;
+            }
+
+            if(isLeaf) {
+                out.push_back(static_cast<GIntBig>(item.offset));
+            }
+            else {
+                queue.push_back(std::make_pair(item.offset, level - 1));
+            }
+        }
+    }
+
+    // Read features in storage order
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+GIntBig SpatialIndex::sourceTime() const
+{
+    return nullptr == m_header ? 0 : m_header->sourceTime;
+}
+
+GUIntBig SpatialIndex::size() const
+{
+    return nullptr == m_header ? 0 : m_header->itemCount;
+}
+
+bool SpatialIndex::init(GByte* data, size_t size)
+{
+    const Header* header = reinterpret_cast<const Header*>(data);
+    if(header->magic != SPATIAL_INDEX_MAGIC) {
+        return false;
+    }
+
+    GUIntBig nodeCount = 0;
+    auto bounds = levelBounds(header->itemCount, header->nodeSize, nodeCount);
+    if(size != sizeof(Header) + static_cast<size_t>(nodeCount) * sizeof(Item)) {
+        return false;
+    }
+
+    m_header = header;
+    m_nodes = reinterpret_cast<const Item*>(data + sizeof(Header));
+    m_nodeCount = nodeCount;
+    m_levelBounds = bounds;
+    return true;
+}
+
+void SpatialIndex::close()
+{
+    if(nullptr != m_mem) {
+        CPLVirtualMemFree(m_mem);
+        m_mem = nullptr;
+    }
+    if(nullptr != m_file) {
+        VSIFCloseL(m_file);
+        m_file = nullptr;
+    }
+    m_buffer.clear();
+    m_header = nullptr;
+    m_nodes = nullptr;
+    m_nodeCount = 0;
+    m_levelBounds.clear();
+}
+
+}
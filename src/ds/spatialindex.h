@@ -0,0 +1,87 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2016-2017 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSSPATIALINDEX_H
+#define NGSSPATIALINDEX_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+// gdal
+#include "cpl_virtualmem.h"
+#include "cpl_vsi.h"
+
+#include "geometry.h"
+
+namespace ngs {
+
+/**
+ * @brief The SpatialIndex class Packed Hilbert R-tree of feature envelopes.
+ * Items are sorted by the Hilbert value of the envelope center and packed to
+ * nodes bottom up, so the tree is built in one pass and never modified. The
+ * tree is stored as the header followed by the node array (root first,
+ * leaves last). Stored tree is memory mapped on open.
+ */
+class SpatialIndex
+{
+public:
+    typedef struct _item {
+        double minX, minY, maxX, maxY;
+        GUIntBig offset; // Feature ID for leaves, first child for nodes.
+    } Item;
+
+public:
+    SpatialIndex();
+    ~SpatialIndex();
+    bool build(std::vector<Item>& items, GIntBig sourceTime);
+    bool open(const char* path);
+    bool save(const char* path) const;
+    std::vector<GIntBig> search(const Envelope& env) const;
+    GIntBig sourceTime() const;
+    GUIntBig size() const;
+
+private:
+    bool init(GByte* data, size_t size);
+    void close();
+
+private:
+    typedef struct _header {
+        GUInt32 magic;
+        GUInt32 nodeSize;
+        GUIntBig itemCount;
+        GIntBig sourceTime;
+    } Header;
+
+private:
+    std::vector<GByte> m_buffer;
+    CPLVirtualMem* m_mem;
+    VSILFILE* m_file;
+    const Header* m_header;
+    const Item* m_nodes;
+    GUIntBig m_nodeCount;
+    std::vector<std::pair<GUIntBig, GUIntBig>> m_levelBounds;
+};
+
+typedef std::shared_ptr<SpatialIndex> SpatialIndexPtr;
+
+}
+
+#endif // NGSSPATIALINDEX_H
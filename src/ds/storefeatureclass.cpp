@@ -20,6 +20,8 @@
  ****************************************************************************/
 #include "storefeatureclass.h"
 
+#include <algorithm>
+
 #include "datastore.h"
 #include "catalog/file.h"
 #include "catalog/folder.h"
@@ -77,6 +79,38 @@ FeaturePtr StoreObject::getFeatureByRemoteId(GIntBig rid) const
     return out;
 }
 
+std::vector<FeaturePtr> StoreObject::getFeaturesByRemoteIds(
+        const std::vector<GIntBig>& rids) const
+{
+    std::vector<FeaturePtr> out;
+    const Table* table = dynamic_cast<const Table*>(this);
+    if(nullptr == table || rids.empty()) {
+        return out;
+    }
+
+    Dataset* dataset = dynamic_cast<Dataset*>(table->parent());
+    DatasetExecuteSQLLockHolder holder(dataset);
+    // Remote identifiers are indexed, so each query is a set of index lookups
+    for(size_t i = 0; i < rids.size(); i += REMOTE_ID_QUERY_SIZE) {
+        size_t end = std::min(rids.size(), i + REMOTE_ID_QUERY_SIZE);
+        CPLString filter;
+        filter.Printf("%s IN (", REMOTE_ID_KEY);
+        for(size_t j = i; j < end; ++j) {
+            filter += CPLSPrintf(j == i ? CPL_FRMT_GIB : "," CPL_FRMT_GIB,
+                                 rids[j]);
+        }
+        filter += ")";
+
+        m_storeIntLayer->SetAttributeFilter(filter);
+        OGRFeature* pFeature;
+        while((pFeature = m_storeIntLayer->GetNextFeature()) != nullptr) {
+            out.push_back(FeaturePtr(pFeature, table));
+        }
+    }
+    m_storeIntLayer->SetAttributeFilter(nullptr);
+    return out;
+}
+
 bool StoreObject::setFeatureAttachmentRemoteId(GIntBig aid, GIntBig rid)
 {
     Table* table = dynamic_cast<Table*>(this);
@@ -312,6 +346,7 @@ std::vector<ngsEditOperation> StoreTable::editOperations()
     }
 
     DatasetExecuteSQLLockHolder holder(dynamic_cast<Dataset*>(m_parent));
+    flushEditHistory();
     return fillEditOperations(m_editHistoryTable);
 }
 
@@ -336,9 +371,6 @@ StoreFeatureClass::StoreFeatureClass(OGRLayer* layer,
     FeatureClass(layer, parent, CAT_FC_GPKG, name),
     StoreObject(layer)
 {
-    if(m_zoomLevels.empty()) {
-        fillZoomLevels();
-    }
 }
 
 void StoreFeatureClass::fillFields()
@@ -459,6 +491,32 @@ CPLString StoreFeatureClass::property(const char* key, const char* defaultValue,
     return item != nullptr ? item : defaultValue;
 }
 
+bool StoreFeatureClass::readStoredExtent(Envelope& extent)
+{
+    CPLString value = property(EXTENT_KEY, "", NG_ADDITIONS_KEY);
+    char** coordinates = CSLTokenizeString2(value, ",", 0);
+    bool result = CSLCount(coordinates) == 4;
+    if(result) {
+        extent = Envelope(CPLAtofM(coordinates[0]), CPLAtofM(coordinates[1]),
+                          CPLAtofM(coordinates[2]), CPLAtofM(coordinates[3]));
+    }
+    CSLDestroy(coordinates);
+    return result;
+}
+
+void StoreFeatureClass::storeExtent(const Envelope& extent)
+{
+    // Empty value forces recalculation on next load
+    if(!extent.isInit()) {
+        setProperty(EXTENT_KEY, "", NG_ADDITIONS_KEY);
+        return;
+    }
+    setProperty(EXTENT_KEY, CPLSPrintf("%.17g,%.17g,%.17g,%.17g",
+                                       extent.minX(), extent.minY(),
+                                       extent.maxX(), extent.maxY()),
+                NG_ADDITIONS_KEY);
+}
+
 std::map<CPLString, CPLString> StoreFeatureClass::properties(const char* domain)
 {
     return propMapFromList(m_layer->GetMetadata(domain));
@@ -481,6 +539,7 @@ std::vector<ngsEditOperation> StoreFeatureClass::editOperations()
     }
 
     DatasetExecuteSQLLockHolder holder(dynamic_cast<Dataset*>(m_parent));
+    flushEditHistory();
     return fillEditOperations(m_editHistoryTable);
 }
 
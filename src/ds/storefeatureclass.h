@@ -26,6 +26,8 @@
 namespace ngs {
 
 constexpr GIntBig INIT_RID_COUNTER = NOT_FOUND; //-1000000;
+constexpr size_t REMOTE_ID_QUERY_SIZE = 5000;
+constexpr const char* EXTENT_KEY = "extent";
 
 class StoreObject
 {
@@ -33,6 +35,8 @@ public:
     StoreObject(OGRLayer* layer);
     virtual ~StoreObject() = default;
     virtual FeaturePtr getFeatureByRemoteId(GIntBig rid) const;
+    virtual std::vector<FeaturePtr> getFeaturesByRemoteIds(
+            const std::vector<GIntBig>& rids) const;
     virtual bool setFeatureAttachmentRemoteId(GIntBig aid, GIntBig rid);
     std::vector<ngsEditOperation> fillEditOperations(
             OGRLayer* editHistoryTable) const;
@@ -77,6 +81,11 @@ protected:
 
 protected:
     virtual void fillFields() override;
+
+    // FeatureClass interface
+protected:
+    virtual bool readStoredExtent(Envelope& extent) override;
+    virtual void storeExtent(const Envelope& extent) override;
 };
 
 class StoreFeatureClass : public FeatureClass, public StoreObject
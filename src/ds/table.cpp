@@ -20,6 +20,8 @@
  ****************************************************************************/
 #include "table.h"
 
+#include <algorithm>
+
 #include "api_priv.h"
 #include "dataset.h"
 #include "catalog/file.h"
@@ -30,6 +32,7 @@
 
 namespace ngs {
 
+constexpr const char* INSERT_SAVEPOINT = "ngs_insert";
 
 //------------------------------------------------------------------------------
 // FieldMapPtr
@@ -81,6 +84,546 @@ FeaturePtr& FeaturePtr::operator=(OGRFeature* feature) {
     return *this;
 }
 
+//------------------------------------------------------------------------------
+// FeatureCursor
+//------------------------------------------------------------------------------
+
+FeatureCursor::FeatureCursor(const Table* table, OGRLayer* layer,
+                             Dataset* dataset, GDALDataset* readHandle,
+                             CPLMutex* featureMutex) :
+    m_table(table),
+    m_layer(layer),
+    m_dataset(dataset),
+    m_readHandle(readHandle),
+    m_featureMutex(featureMutex),
+    m_attributeFilter(false),
+    m_spatialFilter(false),
+    m_ignoredFields(false)
+{
+    // Shared layer is locked while cursor alive
+    if(nullptr == m_readHandle) {
+        if(nullptr != m_dataset) {
+            m_dataset->lockExecuteSql(true);
+        }
+        CPLAcquireMutex(m_featureMutex, 1000.0);
+    }
+    m_layer->ResetReading();
+}
+
+FeatureCursor::~FeatureCursor()
+{
+    // Leave the layer as it was before the cursor
+    if(m_attributeFilter) {
+        m_layer->SetAttributeFilter(nullptr);
+    }
+    if(m_spatialFilter) {
+        m_layer->SetSpatialFilter(nullptr);
+    }
+    if(m_ignoredFields) {
+        m_layer->SetIgnoredFields(nullptr);
+    }
+    m_layer->ResetReading();
+
+    if(nullptr == m_readHandle) {
+        CPLReleaseMutex(m_featureMutex);
+        if(nullptr != m_dataset) {
+            m_dataset->lockExecuteSql(false);
+        }
+    }
+    else {
+        m_dataset->releaseReadHandle(m_readHandle);
+    }
+}
+
+bool FeatureCursor::setFilters(const char* filter,
+                               const OGRGeometry* spatialFilter,
+                               const std::vector<const char*>& ignoredFields)
+{
+    if(nullptr != filter) {
+        m_attributeFilter = true;
+        if(m_layer->SetAttributeFilter(filter) != OGRERR_NONE) {
+            return false;
+        }
+    }
+
+    if(nullptr != spatialFilter) {
+        m_spatialFilter = true;
+        m_layer->SetSpatialFilter(const_cast<OGRGeometry*>(spatialFilter));
+    }
+
+    if(!ignoredFields.empty()) {
+        char** fields = nullptr;
+        for(const char* fieldName : ignoredFields) {
+            fields = CSLAddString(fields, fieldName);
+        }
+        m_ignoredFields = true;
+        OGRErr result = m_layer->SetIgnoredFields(
+                    const_cast<const char**>(fields));
+        CSLDestroy(fields);
+        if(result != OGRERR_NONE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+FeaturePtr FeatureCursor::next()
+{
+    return FeaturePtr(m_layer->GetNextFeature(), m_table);
+}
+
+FeaturePtr FeatureCursor::feature(GIntBig id)
+{
+    OGRFeature* feature = m_layer->GetFeature(id);
+    if(nullptr == feature) {
+        return FeaturePtr();
+    }
+    return FeaturePtr(feature, m_table);
+}
+
+GIntBig FeatureCursor::count(bool force)
+{
+    return m_layer->GetFeatureCount(force ? TRUE : FALSE);
+}
+
+void FeatureCursor::reset()
+{
+    m_layer->ResetReading();
+}
+
+//------------------------------------------------------------------------------
+// FeatureReader
+//------------------------------------------------------------------------------
+
+FeatureReader::FeatureReader(const TablePtr& table, size_t queueSize,
+                             size_t window) :
+    m_table(table),
+    m_queue(queueSize),
+    m_thread(nullptr),
+    m_window(window),
+    m_consumed(0),
+    m_stopped(false),
+    m_windowMutex(CPLCreateMutex()),
+    m_windowCond(CPLCreateCond())
+{
+    CPLReleaseMutex(m_windowMutex);
+}
+
+FeatureReader::~FeatureReader()
+{
+    stop();
+    CPLDestroyCond(m_windowCond);
+    CPLDestroyMutex(m_windowMutex);
+}
+
+void FeatureReader::start()
+{
+    if(nullptr == m_thread) {
+        m_thread = CPLCreateJoinableThread(readThread, this);
+        if(nullptr == m_thread) {
+            // Nothing will be read
+            m_queue.close();
+        }
+    }
+}
+
+void FeatureReader::stop()
+{
+    {
+        CPLMutexHolder holder(m_windowMutex);
+        m_stopped = true;
+        CPLCondBroadcast(m_windowCond);
+    }
+    m_queue.close();
+    if(nullptr != m_thread) {
+        CPLJoinThread(m_thread);
+        m_thread = nullptr;
+    }
+}
+
+/**
+ * @brief FeatureReader::setConsumed Reports the count of features the consumer
+ * finished with. The reader waiting for the window is woken up.
+ * @param count Consumed features count
+ */
+void FeatureReader::setConsumed(GIntBig count)
+{
+    if(0 == m_window) {
+        return;
+    }
+    CPLMutexHolder holder(m_windowMutex);
+    m_consumed = count;
+    CPLCondBroadcast(m_windowCond);
+}
+
+bool FeatureReader::waitWindow(GIntBig index)
+{
+    if(0 == m_window) {
+        return true;
+    }
+    CPLMutexHolder holder(m_windowMutex);
+    while(index - m_consumed >= static_cast<GIntBig>(m_window) &&
+          !m_stopped) {
+        CPLCondWait(m_windowCond, m_windowMutex);
+    }
+    return !m_stopped;
+}
+
+void FeatureReader::readThread(void* data)
+{
+    FeatureReader* reader = static_cast<FeatureReader*>(data);
+    // Source may share the connection with the table written by the consumer
+    Dataset* dataset = dynamic_cast<Dataset*>(reader->m_table->parent());
+    GIntBig index = 0;
+    {
+        DatasetExecuteSQLLockHolder holder(dataset);
+        reader->m_table->reset();
+    }
+    while(true) {
+        // Don't get too far ahead of the consumer
+        if(!reader->waitWindow(index)) {
+            return;
+        }
+        FeaturePtr feature;
+        {
+            DatasetExecuteSQLLockHolder holder(dataset);
+            feature = reader->m_table->nextFeature();
+        }
+        if(!feature) {
+            break;
+        }
+        // Closed queue means the consumer stopped
+        if(!reader->m_queue.push(std::make_pair(index++, feature))) {
+            return;
+        }
+    }
+    reader->m_queue.close();
+}
+
+//------------------------------------------------------------------------------
+// EditHistory
+//------------------------------------------------------------------------------
+
+static GIntBig opFeatureId(const FeaturePtr& opFeature)
+{
+    return opFeature->GetFieldAsInteger64(FEATURE_ID_FIELD);
+}
+
+static GIntBig opAttachmentId(const FeaturePtr& opFeature)
+{
+    return opFeature->GetFieldAsInteger64(ATTACH_FEATURE_ID_FIELD);
+}
+
+static enum ngsChangeCode opCode(const FeaturePtr& opFeature)
+{
+    return static_cast<enum ngsChangeCode>(
+                opFeature->GetFieldAsInteger64(OPERATION_FIELD));
+}
+
+EditHistory::EditHistory() :
+    m_deleteAllCount(0),
+    m_cleared(false),
+    m_loaded(false)
+{
+
+}
+
+size_t EditHistory::pendingCount() const
+{
+    return m_deletedRows.size() + m_updatedItems.size() +
+            m_insertedItems.size();
+}
+
+bool EditHistory::load(OGRLayer* historyTable)
+{
+    reset();
+    if(nullptr == historyTable) {
+        return false;
+    }
+
+    FeaturePtr feature;
+    historyTable->ResetReading();
+    while((feature = historyTable->GetNextFeature())) {
+        add(feature, true);
+    }
+    m_loaded = true;
+    return true;
+}
+
+void EditHistory::reset()
+{
+    m_items.clear();
+    m_deleteAllCount = 0;
+    clearPending();
+    m_loaded = false;
+}
+
+void EditHistory::clearPending()
+{
+    m_deletedRows.clear();
+    m_updatedItems.clear();
+    m_insertedItems.clear();
+    m_cleared = false;
+}
+
+void EditHistory::add(const FeaturePtr& opFeature, bool stored)
+{
+    LogItemPtr item(new LogItem);
+    item->feature = opFeature;
+    item->deleted = false;
+    item->updated = false;
+    m_items[opFeatureId(opFeature)].push_back(item);
+    if(opCode(opFeature) == CC_DELETEALL_FEATURES) {
+        m_deleteAllCount++;
+    }
+    if(!stored) {
+        m_insertedItems.push_back(item);
+    }
+}
+
+void EditHistory::erase(const LogItemPtr& item)
+{
+    // Items not yet written are just skipped on flush
+    if(item->feature->GetFID() != OGRNullFID) {
+        m_deletedRows.push_back(item->feature->GetFID());
+    }
+    item->deleted = true;
+    if(opCode(item->feature) == CC_DELETEALL_FEATURES) {
+        m_deleteAllCount--;
+    }
+}
+
+template<class Predicate>
+void EditHistory::eraseIf(GIntBig fid, Predicate predicate)
+{
+    auto it = m_items.find(fid);
+    if(it == m_items.end()) {
+        return;
+    }
+
+    LogItemList& items = it->second;
+    for(auto itemIt = items.begin(); itemIt != items.end();) {
+        if(predicate(*itemIt)) {
+            erase(*itemIt);
+            itemIt = items.erase(itemIt);
+        }
+        else {
+            ++itemIt;
+        }
+    }
+
+    if(items.empty()) {
+        m_items.erase(it);
+    }
+}
+
+void EditHistory::eraseDeleteAll()
+{
+    if(m_deleteAllCount == 0) {
+        return;
+    }
+
+    std::vector<GIntBig> fids;
+    for(const auto& items : m_items) {
+        fids.push_back(items.first);
+    }
+    for(GIntBig fid : fids) {
+        eraseIf(fid, [](const LogItemPtr& item) {
+            return opCode(item->feature) == CC_DELETEALL_FEATURES;
+        });
+    }
+}
+
+void EditHistory::clear()
+{
+    for(const auto& items : m_items) {
+        for(const LogItemPtr& item : items.second) {
+            item->deleted = true;
+        }
+    }
+    m_items.clear();
+    m_deleteAllCount = 0;
+    // Stored rows are deleted all at once on flush
+    clearPending();
+    m_cleared = true;
+}
+
+void EditHistory::log(const FeaturePtr& opFeature)
+{
+    GIntBig fid = opFeatureId(opFeature);
+    GIntBig aid = opAttachmentId(opFeature);
+    enum ngsChangeCode code = opCode(opFeature);
+
+    if(code == CC_DELETEALL_FEATURES) {
+        clear();
+        add(opFeature);
+        return;
+    }
+
+    if(code == CC_DELETEALL_ATTACHMENTS) {
+        if(fid == NOT_FOUND) {
+            return;
+        }
+        eraseIf(fid, [](const LogItemPtr& item) {
+            return opAttachmentId(item->feature) != NOT_FOUND;
+        });
+        add(opFeature);
+        return;
+    }
+
+    // Check delete all
+    eraseDeleteAll();
+
+    if(code == CC_CREATE_ATTACHMENT || code == CC_CHANGE_ATTACHMENT) {
+        if(fid == NOT_FOUND) {
+            return;
+        }
+        eraseIf(fid, [](const LogItemPtr& item) {
+            return opCode(item->feature) == CC_DELETEALL_ATTACHMENTS;
+        });
+    }
+
+    if(code == CC_CREATE_FEATURE || code == CC_CREATE_ATTACHMENT) {
+        if(fid == NOT_FOUND) {
+            return;
+        }
+        add(opFeature);
+        return;
+    }
+
+    if(fid == NOT_FOUND) {
+        return;
+    }
+
+    auto it = m_items.find(fid);
+    bool hasItems = it != m_items.end();
+
+    if(code == CC_DELETE_FEATURE) {
+        // If feature created and than deleted - nop
+        bool created = false;
+        eraseIf(fid, [&created](const LogItemPtr& item) {
+            if(opCode(item->feature) == CC_CREATE_FEATURE) {
+                created = true;
+            }
+            return true;
+        });
+        if(!created) {
+            add(opFeature);
+        }
+        return;
+    }
+
+    if(code == CC_DELETE_ATTACHMENT) {
+        if(aid == NOT_FOUND) {
+            return;
+        }
+        if(hasItems) {
+            for(const LogItemPtr& item : it->second) {
+                if(opAttachmentId(item->feature) != aid) {
+                    continue;
+                }
+                if(opCode(item->feature) == CC_CREATE_ATTACHMENT) {
+                    LogItemPtr createItem = item;
+                    eraseIf(fid, [&createItem](const LogItemPtr& testItem) {
+                        return testItem == createItem;
+                    });
+                    return;
+                }
+                item->feature->SetField(OPERATION_FIELD, code);
+                if(item->feature->GetFID() != OGRNullFID && !item->updated) {
+                    item->updated = true;
+                    m_updatedItems.push_back(item);
+                }
+                return;
+            }
+        }
+        add(opFeature);
+        return;
+    }
+
+    if(code == CC_CHANGE_FEATURE) {
+        // Check if feature deleted, added or changed - skip
+        if(!hasItems) {
+            add(opFeature);
+        }
+        return;
+    }
+
+    if(code == CC_CHANGE_ATTACHMENT) {
+        if(aid == NOT_FOUND) {
+            return;
+        }
+        // Check if attach deleted, added or changed - skip
+        if(hasItems) {
+            for(const LogItemPtr& item : it->second) {
+                if(opAttachmentId(item->feature) == aid) {
+                    return;
+                }
+            }
+        }
+        add(opFeature);
+        return;
+    }
+}
+
+void EditHistory::remove(GIntBig fid, GIntBig aid)
+{
+    auto it = m_items.find(fid);
+    if(it == m_items.end()) {
+        return;
+    }
+
+    LogItemList& items = it->second;
+    for(auto itemIt = items.begin(); itemIt != items.end();) {
+        const LogItemPtr& item = *itemIt;
+        if(opAttachmentId(item->feature) == aid) {
+            item->deleted = true;
+            if(opCode(item->feature) == CC_DELETEALL_FEATURES) {
+                m_deleteAllCount--;
+            }
+            itemIt = items.erase(itemIt);
+        }
+        else {
+            ++itemIt;
+        }
+    }
+
+    if(items.empty()) {
+        m_items.erase(it);
+    }
+}
+
+void EditHistory::flush(OGRLayer* historyTable)
+{
+    for(GIntBig row : m_deletedRows) {
+        if(historyTable->DeleteFeature(row) != OGRERR_NONE) {
+            CPLDebug("ngstore", "Failed delete log item");
+        }
+    }
+
+    for(const LogItemPtr& item : m_updatedItems) {
+        item->updated = false;
+        if(item->deleted) {
+            continue;
+        }
+        if(historyTable->SetFeature(item->feature) != OGRERR_NONE) {
+            CPLDebug("ngstore", "Failed update log item");
+        }
+    }
+
+    for(const LogItemPtr& item : m_insertedItems) {
+        if(item->deleted) {
+            continue;
+        }
+        if(historyTable->CreateFeature(item->feature) != OGRERR_NONE) {
+            CPLDebug("ngstore", "Log operation %d failed",
+                     opCode(item->feature));
+        }
+    }
+
+    clearPending();
+}
+
 //------------------------------------------------------------------------------
 // Table
 //------------------------------------------------------------------------------
@@ -165,6 +708,81 @@ bool Table::insertFeature(const FeaturePtr &feature, bool logEdits)
     return errorMessage(CPLGetLastErrorMsg());
 }
 
+bool Table::insertFeatures(const std::vector<FeaturePtr>& features,
+                           bool logEdits)
+{
+    if(nullptr == m_layer)
+        return false;
+
+    if(features.empty()) {
+        return true;
+    }
+
+    CPLErrorReset();
+    Dataset* dataset = dynamic_cast<Dataset*>(m_parent);
+    DatasetExecuteSQLLockHolder holder(dataset);
+    // All or nothing. Batch operation is already a transaction, so a savepoint
+    // inside it is used. Drivers without transactions support insert features
+    // one by one.
+    bool inBatch = dataset && dataset->isBatchOperation();
+    if(inBatch) {
+        dataset->executeStatement(CPLSPrintf("SAVEPOINT %s", INSERT_SAVEPOINT),
+                                  "SQLITE");
+    }
+    bool transaction = inBatch || m_layer->StartTransaction() == OGRERR_NONE;
+    for(size_t i = 0; i < features.size(); ++i) {
+        if(m_layer->CreateFeature(features[i]) != OGRERR_NONE) {
+            CPLString error = CPLGetLastErrorMsg();
+            if(inBatch) {
+                dataset->executeStatement(CPLSPrintf("ROLLBACK TO SAVEPOINT %s",
+                                                     INSERT_SAVEPOINT), "SQLITE");
+                dataset->executeStatement(CPLSPrintf("RELEASE SAVEPOINT %s",
+                                                     INSERT_SAVEPOINT), "SQLITE");
+            }
+            else if(transaction) {
+                m_layer->RollbackTransaction();
+            }
+            if(transaction) {
+                // Nothing stored, so forget identifiers set by the driver
+                for(size_t j = 0; j <= i; ++j) {
+                    features[j]->SetFID(OGRNullFID);
+                }
+            }
+            return errorMessage(error.c_str());
+        }
+    }
+
+    if(inBatch) {
+        dataset->executeStatement(CPLSPrintf("RELEASE SAVEPOINT %s",
+                                             INSERT_SAVEPOINT), "SQLITE");
+    }
+    else if(transaction && m_layer->CommitTransaction() != OGRERR_NONE) {
+        for(const FeaturePtr& feature : features) {
+            feature->SetFID(OGRNullFID);
+        }
+        return errorMessage(CPLGetLastErrorMsg());
+    }
+
+    if(logEdits) {
+        std::vector<FeaturePtr> opFeatures;
+        opFeatures.reserve(features.size());
+        for(const FeaturePtr& feature : features) {
+            FeaturePtr opFeature = logEditFeature(feature, FeaturePtr(),
+                                                  CC_CREATE_FEATURE);
+            if(opFeature) {
+                opFeatures.push_back(opFeature);
+            }
+        }
+        logEditOperations(opFeatures);
+    }
+
+    if(dataset && !dataset->isBatchOperation()) {
+        Notify::instance().onNotify(fullName(),
+                                    ngsChangeCode::CC_CREATE_FEATURE);
+    }
+    return true;
+}
+
 bool Table::updateFeature(const FeaturePtr &feature, bool logEdits)
 {
     if(nullptr == m_layer)
@@ -274,6 +892,43 @@ FeaturePtr Table::nextFeature() const
     return FeaturePtr(m_layer->GetNextFeature(), this);
 }
 
+FeatureCursorPtr Table::openCursor(const char* filter,
+                                   const OGRGeometry* spatialFilter,
+                                   const std::vector<const char*>& ignoredFields) const
+{
+    if(nullptr == m_layer) {
+        return FeatureCursorPtr();
+    }
+
+    Dataset* dataset = dynamic_cast<Dataset*>(m_parent);
+    GDALDataset* readHandle = nullptr;
+    OGRLayer* layer = m_layer;
+    if(nullptr != dataset && m_type != CAT_QUERY_RESULT &&
+            m_type != CAT_QUERY_RESULT_FC) {
+        // Own connection does not touch the main one, schema changes still
+        // must not run while the layer is looked up
+        DatasetExecuteSQLLockHolder holder(dataset, true);
+        readHandle = dataset->acquireReadHandle();
+        if(nullptr != readHandle) {
+            layer = readHandle->GetLayerByName(m_layer->GetName());
+            if(nullptr == layer) {
+                // Handle opened before the table was created
+                dataset->releaseReadHandle(readHandle, false);
+                readHandle = nullptr;
+                layer = m_layer;
+            }
+        }
+    }
+
+    FeatureCursorPtr cursor(new FeatureCursor(this, layer, dataset, readHandle,
+                                              m_featureMutex));
+    if(!cursor->setFilters(filter, spatialFilter, ignoredFields)) {
+        errorMessage(CPLGetLastErrorMsg());
+        return FeatureCursorPtr();
+    }
+    return cursor;
+}
+
 int Table::copyRows(const TablePtr srcTable, const FieldMapPtr fieldMap,
                      const Progress& progress)
 {
@@ -289,9 +944,12 @@ int Table::copyRows(const TablePtr srcTable, const FieldMapPtr fieldMap,
 
     GIntBig featureCount = srcTable->featureCount();
     double counter = 0;
-    srcTable->reset();
-    FeaturePtr feature;
-    while((feature = srcTable->nextFeature ())) {
+    // Source is read in own thread while rows are inserted
+    FeatureReader reader(srcTable);
+    reader.start();
+    FeatureReader::Item item;
+    while(reader.queue().pop(item)) {
+        FeaturePtr feature = item.second;
         double complete = counter / featureCount;
         if(!progress.onProgress(COD_IN_PROCESS, complete,
                            _("Copy in process ..."))) {
@@ -661,7 +1319,8 @@ void Table::checkSetProperty(const char* key, const char* value, const char* dom
         char prevValue = m_saveEditHistory;
         m_saveEditHistory = EQUAL(value, "ON") ? 1 : 0;
         if(prevValue != m_saveEditHistory && prevValue == 1) {
-            // Clear history table
+            // Clear pending history and history table
+            discardEditHistory();
             Dataset* parentDataset = dynamic_cast<Dataset*>(m_parent);
             if(nullptr != parentDataset) {
                 parentDataset->clearEditHistoryTable(m_name);
@@ -751,189 +1410,7 @@ void Table::logEditOperation(FeaturePtr opFeature)
         return;
     }
 
-    GIntBig fid = opFeature->GetFieldAsInteger64(FEATURE_ID_FIELD);
-    GIntBig aid = opFeature->GetFieldAsInteger64(ATTACH_FEATURE_ID_FIELD);
-    enum ngsChangeCode code =
-            static_cast<enum ngsChangeCode>(opFeature->GetFieldAsInteger64(
-                                                OPERATION_FIELD));
-
-    Dataset* parentDataset = dynamic_cast<Dataset*>(m_parent);
-    if(nullptr == parentDataset) {
-        return;
-    }
-
-    DatasetExecuteSQLLockHolder holder(parentDataset);
-    if(code == CC_DELETEALL_FEATURES) {
-        parentDataset->clearEditHistoryTable(name());
-
-        if(m_editHistoryTable->CreateFeature(opFeature) != OGRERR_NONE) {
-            CPLDebug("ngstore", "Log operation %d failed", code);
-        }
-
-        return;
-    }
-
-    GDALDataset* addsDS = parentDataset->m_addsDS;
-    if(code == CC_DELETEALL_ATTACHMENTS) {
-        if(fid == NOT_FOUND) {
-            return;
-        }
-        addsDS->ExecuteSQL(CPLSPrintf("DELETE FROM %s WHERE %s = " CPL_FRMT_GIB " AND %s <> -1",
-                                       parentDataset->historyTableName(m_name),
-                                       FEATURE_ID_FIELD, fid, ATTACH_FEATURE_ID_FIELD),
-                           nullptr, nullptr);
-        if(m_editHistoryTable->CreateFeature(opFeature) != OGRERR_NONE) {
-            CPLDebug("ngstore", "Log operation %d failed", code);
-        }
-
-        return;
-    }
-
-    // Check delete all
-    addsDS->ExecuteSQL(CPLSPrintf("DELETE FROM %s WHERE %s = %d",
-                                   parentDataset->historyTableName(m_name),
-                                   OPERATION_FIELD, CC_DELETEALL_FEATURES),
-                       nullptr, nullptr);
-
-    if(code == CC_CREATE_ATTACHMENT || code == CC_CHANGE_ATTACHMENT) {
-        if(fid == NOT_FOUND) {
-            return;
-        }
-        addsDS->ExecuteSQL(CPLSPrintf("DELETE FROM %s WHERE %s = %d AND %s = " CPL_FRMT_GIB,
-                                       parentDataset->historyTableName(m_name),
-                                       OPERATION_FIELD, CC_DELETEALL_ATTACHMENTS,
-                                       FEATURE_ID_FIELD, fid),
-                           nullptr, nullptr);
-    }
-
-    if(code == CC_CREATE_FEATURE || code == CC_CREATE_ATTACHMENT) {
-        if(fid == NOT_FOUND) {
-            return;
-        }
-
-        if(m_editHistoryTable->CreateFeature(opFeature) != OGRERR_NONE) {
-            CPLDebug("ngstore", "Log operation %d failed", code);
-        }
-
-        return;
-    }
-
-    m_editHistoryTable->SetAttributeFilter(CPLSPrintf("%s = " CPL_FRMT_GIB, FEATURE_ID_FIELD, fid));
-    std::vector<FeaturePtr> features;
-    FeaturePtr f;
-    while((f = m_editHistoryTable->GetNextFeature())) {
-        features.push_back(f);
-    }
-    m_editHistoryTable->SetAttributeFilter(nullptr);
-
-    if(code == CC_DELETE_FEATURE) {
-        if(fid == NOT_FOUND) {
-            return;
-        }
-
-        if(!features.empty()) {
-            addsDS->ExecuteSQL(CPLSPrintf("DELETE FROM %s WHERE %s = " CPL_FRMT_GIB,
-                                       parentDataset->historyTableName(m_name),
-                                       FEATURE_ID_FIELD, fid),
-                           nullptr, nullptr);
-        }
-
-        // If feature created and than deleted - nop
-        for(auto feature : features) {
-            enum ngsChangeCode testCode = static_cast<enum ngsChangeCode>(
-                        feature->GetFieldAsInteger64(OPERATION_FIELD));
-
-            if(testCode == CC_CREATE_FEATURE) {
-                return;
-            }
-        }
-
-        // Add new operation
-        if(m_editHistoryTable->CreateFeature(opFeature) != OGRERR_NONE) {
-            CPLDebug("ngstore", "Log operation %d failed", code);
-        }
-
-        return;
-    }
-
-    if(code == CC_DELETE_ATTACHMENT) {
-        if(fid == NOT_FOUND || aid == NOT_FOUND) {
-            return;
-        }
-        FeaturePtr attFeature;
-        for(auto feature : features) {
-            GIntBig testAid = feature->GetFieldAsInteger64(ATTACH_FEATURE_ID_FIELD);
-            if(testAid == aid) {
-                attFeature = feature;
-                enum ngsChangeCode testCode = static_cast<enum ngsChangeCode>(
-                            feature->GetFieldAsInteger64(OPERATION_FIELD));
-
-                if(testCode == CC_CREATE_ATTACHMENT) {
-                    if(m_editHistoryTable->DeleteFeature(feature->GetFID()) !=
-                            OGRERR_NONE) {
-                        CPLDebug("ngstore", "Failed delete log item");
-                    }
-                    return;
-                }
-                break;
-            }
-        }
-
-        if(attFeature) {
-            attFeature->SetField(OPERATION_FIELD, code);
-            if(m_editHistoryTable->SetFeature(attFeature) != OGRERR_NONE) {
-                CPLDebug("ngstore", "Failed update log item");
-            }
-            return;
-        }
-
-        if(m_editHistoryTable->CreateFeature(opFeature) != OGRERR_NONE) {
-            CPLDebug("ngstore", "Log operation %d failed", code);
-        }
-
-        return;
-    }
-
-    if(code == CC_CHANGE_FEATURE) {
-        if(fid == NOT_FOUND) {
-            return;
-        }
-        // Check if feature deleted - skip
-        // Check if feature added. If added - skip
-        // Check if feature changed. If changed - skip
-        if(!features.empty()) {
-            return;
-        }
-        // Add new operation
-        if(m_editHistoryTable->CreateFeature(opFeature) != OGRERR_NONE) {
-            CPLDebug("ngstore", "Log operation %d failed", code);
-        }
-
-        return;
-    }
-
-    if(code == CC_CHANGE_ATTACHMENT) {
-        if(fid == NOT_FOUND || aid == NOT_FOUND) {
-            return;
-        }
-        // Check if attach deleted - skip
-        // Check if attach added. If added - skip
-        // Check if attach changed. If changed - skip
-        for(auto feature : features) {
-            GIntBig testAid = feature->GetFieldAsInteger64(ATTACH_FEATURE_ID_FIELD);
-            if(testAid == aid) {
-                return;
-            }
-        }
-
-        // Add new operation
-        if(m_editHistoryTable->CreateFeature(opFeature) != OGRERR_NONE) {
-            CPLDebug("ngstore", "Log operation %d failed", code);
-        }
-
-        return;
-    }
-
+    logEditOperations({opFeature});
 }
 
 void Table::deleteEditOperation(const ngsEditOperation& op)
@@ -944,6 +1421,7 @@ void Table::deleteEditOperation(const ngsEditOperation& op)
     }
 
     DatasetExecuteSQLLockHolder holder(parentDataset);
+    flushEditHistory();
 
     GDALDataset* addsDS = parentDataset->m_addsDS;
     addsDS->ExecuteSQL(CPLSPrintf("DELETE FROM %s WHERE %s = " CPL_FRMT_GIB " AND %s = " CPL_FRMT_GIB /*" AND %s = %d"*/,
@@ -952,6 +1430,7 @@ void Table::deleteEditOperation(const ngsEditOperation& op)
                                   ATTACH_FEATURE_ID_FIELD, op.aid/*,
                                   OPERATION_FIELD, op.code*/),
                            nullptr, nullptr);
+    m_editHistory.remove(op.fid, op.aid);
 }
 
 std::vector<ngsEditOperation> Table::editOperations()
@@ -966,6 +1445,7 @@ std::vector<ngsEditOperation> Table::editOperations()
     }
 
     DatasetExecuteSQLLockHolder holder(dynamic_cast<Dataset*>(m_parent));
+    flushEditHistory();
     FeaturePtr feature;
     m_editHistoryTable->ResetReading();
     while((feature = m_editHistoryTable->GetNextFeature())) {
@@ -981,6 +1461,62 @@ std::vector<ngsEditOperation> Table::editOperations()
     return out;
 }
 
+void Table::logEditOperations(const std::vector<FeaturePtr>& opFeatures)
+{
+    if(opFeatures.empty() || nullptr == m_editHistoryTable) {
+        return;
+    }
+
+    Dataset* parentDataset = dynamic_cast<Dataset*>(m_parent);
+    if(nullptr == parentDataset) {
+        return;
+    }
+
+    DatasetExecuteSQLLockHolder holder(parentDataset);
+    if(!m_editHistory.isLoaded() && !m_editHistory.load(m_editHistoryTable)) {
+        return;
+    }
+
+    for(const FeaturePtr& opFeature : opFeatures) {
+        m_editHistory.log(opFeature);
+    }
+
+    // Batch operation writes history on stop
+    if(!parentDataset->isBatchOperation() ||
+            m_editHistory.pendingCount() >= EDIT_HISTORY_FLUSH_SIZE) {
+        flushEditHistory();
+    }
+}
+
+void Table::flushEditHistory()
+{
+    Dataset* parentDataset = dynamic_cast<Dataset*>(m_parent);
+    if(nullptr == parentDataset || nullptr == m_editHistoryTable) {
+        return;
+    }
+
+    DatasetExecuteSQLLockHolder holder(parentDataset);
+    if(m_editHistory.pendingCount() == 0 && !m_editHistory.isCleared()) {
+        return;
+    }
+
+    bool transaction = !parentDataset->isBatchOperation() &&
+            m_editHistoryTable->StartTransaction() == OGRERR_NONE;
+    if(m_editHistory.isCleared()) {
+        parentDataset->clearEditHistoryTable(name());
+    }
+    m_editHistory.flush(m_editHistoryTable);
+    if(transaction) {
+        m_editHistoryTable->CommitTransaction();
+    }
+}
+
+void Table::discardEditHistory()
+{
+    DatasetExecuteSQLLockHolder holder(dynamic_cast<Dataset*>(m_parent));
+    m_editHistory.reset();
+}
+
 FeaturePtr Table::logEditFeature(FeaturePtr feature, FeaturePtr attachFeature,
                                       enum ngsChangeCode code)
 {
@@ -21,15 +21,21 @@
 #ifndef NGSTABLE_H
 #define NGSTABLE_H
 
+#include <list>
+#include <map>
+
 // gdal
 #include "ogrsf_frmts.h"
 
 #include "catalog/object.h"
 #include "ngstore/codes.h"
+#include "util/threadpool.h"
 
 namespace ngs {
 
 constexpr const char* LOG_EDIT_HISTORY_KEY = "LOG_EDIT_HISTORY";
+constexpr size_t EDIT_HISTORY_FLUSH_SIZE = 1000;
+constexpr size_t COPY_QUEUE_SIZE = 256;
 
 class FieldMapPtr : public std::shared_ptr<int>
 {
@@ -64,6 +70,125 @@ private:
 
 typedef std::shared_ptr<Table> TablePtr;
 
+class Dataset;
+class FeatureCursor;
+typedef std::shared_ptr<FeatureCursor> FeatureCursorPtr;
+
+/**
+ * @brief The FeatureCursor class Reads table features with own filters. If the
+ * dataset can give a read only connection the cursor does not block other
+ * readers, otherwise the table is locked until the cursor is destroyed.
+ */
+class FeatureCursor
+{
+public:
+    FeatureCursor(const Table* table, OGRLayer* layer, Dataset* dataset,
+                  GDALDataset* readHandle, CPLMutex* featureMutex);
+    ~FeatureCursor();
+    FeaturePtr next();
+    FeaturePtr feature(GIntBig id);
+    GIntBig count(bool force = false);
+    void reset();
+    bool setFilters(const char* filter, const OGRGeometry* spatialFilter,
+                    const std::vector<const char*>& ignoredFields);
+
+private:
+    FeatureCursor(FeatureCursor const&) = delete;
+    FeatureCursor& operator= (FeatureCursor const&) = delete;
+
+protected:
+    const Table* m_table;
+    OGRLayer* m_layer;
+    Dataset* m_dataset;
+    GDALDataset* m_readHandle;
+    CPLMutex* m_featureMutex;
+    bool m_attributeFilter, m_spatialFilter, m_ignoredFields;
+};
+
+/**
+ * @brief The FeatureReader class Reads table features in own thread to the
+ * bounded queue. Features are numbered in the read order. The queue is closed
+ * when all features are read. If the window is set, the reader does not get
+ * more than window features ahead of the count reported by setConsumed.
+ */
+class FeatureReader
+{
+public:
+    typedef std::pair<GIntBig, FeaturePtr> Item;
+    typedef BoundedQueue<Item> Queue;
+
+public:
+    explicit FeatureReader(const TablePtr& table,
+                           size_t queueSize = COPY_QUEUE_SIZE,
+                           size_t window = 0);
+    ~FeatureReader();
+    void start();
+    void stop();
+    void setConsumed(GIntBig count);
+    Queue& queue() { return m_queue; }
+
+private:
+    FeatureReader(FeatureReader const&) = delete;
+    FeatureReader& operator= (FeatureReader const&) = delete;
+    static void readThread(void* data);
+    bool waitWindow(GIntBig index);
+
+private:
+    TablePtr m_table;
+    Queue m_queue;
+    CPLJoinableThread* m_thread;
+    size_t m_window;
+    GIntBig m_consumed;
+    bool m_stopped;
+    CPLMutex* m_windowMutex;
+    CPLCond* m_windowCond;
+};
+
+/**
+ * @brief The EditHistory class In-memory copy of the table edit history.
+ * Edit operations are coalesced per feature identifier and changes are written
+ * to the history table together on flush.
+ */
+class EditHistory
+{
+public:
+    EditHistory();
+    bool isLoaded() const { return m_loaded; }
+    bool isCleared() const { return m_cleared; }
+    size_t pendingCount() const;
+    bool load(OGRLayer* historyTable);
+    void reset();
+    void log(const FeaturePtr& opFeature);
+    void remove(GIntBig fid, GIntBig aid);
+    void flush(OGRLayer* historyTable);
+
+protected:
+    typedef struct _logItem {
+        FeaturePtr feature;
+        bool deleted;
+        bool updated;
+    } LogItem;
+    typedef std::shared_ptr<LogItem> LogItemPtr;
+    typedef std::list<LogItemPtr> LogItemList;
+
+    void add(const FeaturePtr& opFeature, bool stored = false);
+    void erase(const LogItemPtr& item);
+    template<class Predicate>
+    void eraseIf(GIntBig fid, Predicate predicate);
+    void eraseDeleteAll();
+    void clear();
+    void clearPending();
+
+protected:
+    std::map<GIntBig, LogItemList> m_items;
+    std::vector<GIntBig> m_deletedRows;
+    std::vector<LogItemPtr> m_updatedItems;
+    std::vector<LogItemPtr> m_insertedItems;
+    size_t m_deleteAllCount;
+    bool m_cleared;
+    bool m_loaded;
+};
+
 class Table : public Object
 {
     friend class Dataset;
@@ -87,6 +212,8 @@ public:
     FeaturePtr createFeature() const;
     FeaturePtr getFeature(GIntBig id) const;
     virtual bool insertFeature(const FeaturePtr& feature, bool logEdits = true);
+    virtual bool insertFeatures(const std::vector<FeaturePtr>& features,
+                                bool logEdits = true);
     virtual bool updateFeature(const FeaturePtr& feature, bool logEdits = true);
     virtual bool deleteFeature(GIntBig id, bool logEdits = true);
     virtual bool deleteFeatures(bool logEdits = true);
@@ -94,6 +221,10 @@ public:
     void reset() const;
     void setAttributeFilter(const char* filter);
     FeaturePtr nextFeature() const;
+    FeatureCursorPtr openCursor(const char* filter = nullptr,
+                                const OGRGeometry* spatialFilter = nullptr,
+                                const std::vector<const char*>& ignoredFields =
+            std::vector<const char*>()) const;
     virtual int copyRows(const TablePtr srcTable,
                          const FieldMapPtr fieldMap,
                          const Progress& progress = Progress());
@@ -116,6 +247,8 @@ public:
     // Edit log
     virtual void deleteEditOperation(const ngsEditOperation& op);
     virtual std::vector<ngsEditOperation> editOperations();
+    void flushEditHistory();
+    void discardEditHistory();
 
     // Object interface
 public:
@@ -134,6 +267,7 @@ protected:
     CPLString getAttachmentsPath() const;
     virtual void fillFields();
     virtual void logEditOperation(FeaturePtr opFeature);
+    virtual void logEditOperations(const std::vector<FeaturePtr>& opFeatures);
     virtual FeaturePtr logEditFeature(FeaturePtr feature, FeaturePtr attachFeature,
                                       enum ngsChangeCode code);
     virtual void checkSetProperty(const char* key, const char* value,
@@ -145,6 +279,7 @@ protected:
     OGRLayer* m_layer;
     OGRLayer* m_attTable;
     OGRLayer* m_editHistoryTable;
+    EditHistory m_editHistory;
     char m_saveEditHistory;
     std::vector<Field> m_fields;
     CPLMutex* m_featureMutex;
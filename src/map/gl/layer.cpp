@@ -87,8 +87,18 @@ bool GlFeatureLayer::fill(GlTilePtr tile, float z, bool /*isLastTry*/)
         return true;
     }
 
+    // Tile may leave the view while the job waits or runs
+    if(tile->isCancelled()) {
+        return true;
+    }
+
     VectorGlObject *bufferArray = nullptr;
-    VectorTile vtile = m_featureClass->getTile(tile->getTile(), tile->getExtent());
+    VectorTileView vtile = m_featureClass->getTileView(tile->getTile(),
+                                                      tile->getExtent());
+    if(tile->isCancelled()) {
+        return true;
+    }
+
     if(vtile.empty()) {
         CPLMutexHolder holder(m_dataMutex, lockTime);
         m_tiles[tile->getTile()] = GlObjectPtr();
@@ -115,6 +125,11 @@ bool GlFeatureLayer::fill(GlTilePtr tile, float z, bool /*isLastTry*/)
         return true;
     }
 
+    if(tile->isCancelled()) {
+        delete bufferArray;
+        return true;
+    }
+
     CPLMutexHolder holder(m_dataMutex, lockTime);
     m_tiles[tile->getTile()] = GlObjectPtr(bufferArray);
 
@@ -216,23 +231,19 @@ void GlFeatureLayer::setFeatureClass(const FeatureClassPtr &featureClass)
     }
 }
 
-VectorGlObject *GlFeatureLayer::fillPoints(const VectorTile &tile, float z)
+VectorGlObject *GlFeatureLayer::fillPoints(VectorTileView &tile, float z)
 {
     VectorGlObject *bufferArray = new VectorGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
+    VectorTileItemView tileItem;
     unsigned short index = 0;
     GlBuffer *buffer = new GlBuffer(GlBuffer::BF_PT);
     PointStyle* style = ngsDynamicCast(PointStyle, m_style);
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
+    while(tile.next(tileItem)) {
         if(!m_hideFIDs.empty() && tileItem.isIdsPresent(m_hideFIDs)) {
-            ++it;
             continue;
         }
 
         if(tileItem.pointCount() < 1) {
-            ++it;
             continue;
         }
 
@@ -243,10 +254,9 @@ VectorGlObject *GlFeatureLayer::fillPoints(const VectorTile &tile, float z)
                 buffer = new GlBuffer(GlBuffer::BF_PT);
             }
 
-            const SimplePoint& pt = tileItem.point(i);
+            SimplePoint pt = tileItem.point(i);
             index = style->addPoint(pt, z, index, buffer);
         }
-        ++it;
     }
 
     bufferArray->addBuffer(buffer);
@@ -254,24 +264,20 @@ VectorGlObject *GlFeatureLayer::fillPoints(const VectorTile &tile, float z)
     return bufferArray;
 }
 
-VectorGlObject *GlFeatureLayer::fillLines(const VectorTile &tile, float z)
+VectorGlObject *GlFeatureLayer::fillLines(VectorTileView &tile, float z)
 {
     VectorGlObject *bufferArray = new VectorGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
+    VectorTileItemView tileItem;
     unsigned short index = 0;
     GlBuffer *buffer = new GlBuffer(GlBuffer::BF_LINE);
     SimpleLineStyle* style = ngsStaticCast(SimpleLineStyle, m_style);
 
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
+    while(tile.next(tileItem)) {
         if(tileItem.isIdsPresent(m_hideFIDs)) {
-            ++it;
             continue;
         }
 
         if(tileItem.pointCount() < 2) {
-            ++it;
             continue;
         }
 
@@ -280,8 +286,8 @@ VectorGlObject *GlFeatureLayer::fillLines(const VectorTile &tile, float z)
 
         Normal prevNormal;
         for(size_t i = 0; i < tileItem.pointCount() - 1; ++i) {
-            const SimplePoint& pt1 = tileItem.point(i);
-            const SimplePoint& pt2 = tileItem.point(i + 1);
+            SimplePoint pt1 = tileItem.point(i);
+            SimplePoint pt2 = tileItem.point(i + 1);
             Normal normal = ngsGetNormals(pt1, pt2);
 
             if(i == 0 || i == tileItem.pointCount() - 2) { // Add cap
@@ -332,48 +338,42 @@ VectorGlObject *GlFeatureLayer::fillLines(const VectorTile &tile, float z)
             index = style->addSegment(pt1, pt2, normal, z, index, buffer);
             prevNormal = normal;
         }
-        ++it;
     }
     bufferArray->addBuffer(buffer);
 
     return bufferArray;
 }
 
-VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
+VectorGlObject *GlFeatureLayer::fillPolygons(VectorTileView &tile, float z)
 {
     VectorGlObject *bufferArray = new VectorGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
+    VectorTileItemView tileItem;
     unsigned short fillIndex = 0;
     unsigned short lineIndex = 0;
     GlBuffer *fillBuffer = new GlBuffer(GlBuffer::BF_FILL);
     GlBuffer *lineBuffer = new GlBuffer(GlBuffer::BF_LINE);
     SimpleLineStyle* style = ngsStaticCast(SimpleLineStyle, m_style);
 
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
+    while(tile.next(tileItem)) {
         if(tileItem.isIdsPresent(m_hideFIDs)) {
-            ++it;
             continue;
         }
 
-        auto points = tileItem.points();
-        auto indices = tileItem.indices();
-
-        if(points.size() < 3 || points.size() > GlBuffer::maxIndices() ||
-                points.size() > GlBuffer::maxVertices()) {
-            ++it;
+        if(tileItem.pointCount() < 3 ||
+                tileItem.pointCount() > GlBuffer::maxIndices() ||
+                tileItem.pointCount() > GlBuffer::maxVertices()) {
             continue;
         }
 
         // Fill polygons
-        if(!fillBuffer->canStoreVertices(points.size() * 3, false)) {
+        if(!fillBuffer->canStoreVertices(tileItem.pointCount() * 3, false)) {
             bufferArray->addBuffer(fillBuffer);
             fillIndex = 0;
             fillBuffer = new GlBuffer(GlBuffer::BF_FILL);
         }
 
-        for(auto point : points) {
+        for(size_t i = 0; i < tileItem.pointCount(); ++i) {
+            SimplePoint point = tileItem.point(i);
             fillBuffer->addVertex(point.x);
             fillBuffer->addVertex(point.y);
             fillBuffer->addVertex(z);
@@ -381,7 +381,8 @@ VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
 
         // FIXME: Expected indices should fit to buffer as points can
         unsigned short maxFillIndex = 0;
-        for(auto indexPoint : indices) {
+        for(size_t i = 0; i < tileItem.indexCount(); ++i) {
+            unsigned short indexPoint = tileItem.index(i);
             fillBuffer->addIndex(fillIndex + indexPoint);
             if(maxFillIndex < indexPoint) {
                 maxFillIndex = indexPoint;
@@ -394,18 +395,17 @@ VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
         // FIXME: May be more styles with borders
         if(EQUAL(m_style->name(), "simpleFillBordered")) {
 
-        auto borders = (*it).borderIndices();
-        for(auto border : borders) {
+        for(size_t ring = 0; ring < tileItem.borderCount(); ++ring) {
             Normal prevNormal;
             Normal firstNormal;
             bool firstNormalSet = false;
-            for(size_t i = 0; i < border.size() - 1; ++i) {
-                auto borderIndex = border[i];
-                auto borderIndex1 = border[i + 1];
-                Normal normal = ngsGetNormals(points[borderIndex],
-                                              points[borderIndex1]);
+            for(size_t i = 0; i < tileItem.borderSize(ring) - 1; ++i) {
+                auto borderIndex = tileItem.borderIndex(ring, i);
+                auto borderIndex1 = tileItem.borderIndex(ring, i + 1);
+                Normal normal = ngsGetNormals(tileItem.point(borderIndex),
+                                              tileItem.point(borderIndex1));
 
-                if(i == border.size() - 2) {
+                if(i == tileItem.borderSize(ring) - 2) {
                     if(!lineBuffer->canStoreVertices(style->lineCapVerticesCount(),
                                                      true)) {
                         bufferArray->addBuffer(lineBuffer);
@@ -416,7 +416,7 @@ VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
                     Normal reverseNormal;
                     reverseNormal.x = -normal.x;
                     reverseNormal.y = -normal.y;
-                    lineIndex = style->addLineJoin(points[borderIndex1],
+                    lineIndex = style->addLineJoin(tileItem.point(borderIndex1),
                            firstNormal, reverseNormal, z, lineIndex, lineBuffer);
                 }
 
@@ -427,7 +427,7 @@ VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
                         lineIndex = 0;
                         lineBuffer = new GlBuffer(GlBuffer::BF_LINE);
                     }
-                    lineIndex = style->addLineJoin(points[borderIndex],
+                    lineIndex = style->addLineJoin(tileItem.point(borderIndex),
                                    prevNormal, normal, z, lineIndex, lineBuffer);
                 }
 
@@ -437,9 +437,9 @@ VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
                     lineBuffer = new GlBuffer(GlBuffer::BF_LINE);
                 }
 
-                lineIndex = style->addSegment(points[borderIndex],
-                                              points[borderIndex1], normal, z,
-                                              lineIndex, lineBuffer);
+                lineIndex = style->addSegment(tileItem.point(borderIndex),
+                                              tileItem.point(borderIndex1),
+                                              normal, z, lineIndex, lineBuffer);
 
                 prevNormal = normal;
                 if(!firstNormalSet) {
@@ -450,8 +450,6 @@ VectorGlObject *GlFeatureLayer::fillPolygons(const VectorTile &tile, float z)
             }
         }
         }
-
-        ++it;
     }
 
     bufferArray->addBuffer(fillBuffer);
@@ -520,12 +518,11 @@ bool GlSelectableFeatureLayer::drawSelection(GlTilePtr tile)
     return true;
 }
 
-VectorGlObject* GlSelectableFeatureLayer::fillPoints(const VectorTile& tile,
+VectorGlObject* GlSelectableFeatureLayer::fillPoints(VectorTileView& tile,
                                                      float z)
 {
     VectorSelectableGlObject *bufferArray = new VectorSelectableGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
+    VectorTileItemView tileItem;
     unsigned short index = 0;
     GlBuffer* buffer = nullptr;
     PointStyle* style = nullptr;
@@ -537,15 +534,12 @@ VectorGlObject* GlSelectableFeatureLayer::fillPoints(const VectorTile& tile,
     unsigned short drawIndex = 0;
     unsigned short selectIndex = 0;
 
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
+    while(tile.next(tileItem)) {
         if(tileItem.isIdsPresent(m_hideFIDs, true)) {
-            ++it;
             continue;
         }
 
         if(tileItem.pointCount() < 1) {
-            ++it;
             continue;
         }
 
@@ -579,10 +573,9 @@ VectorGlObject* GlSelectableFeatureLayer::fillPoints(const VectorTile& tile,
                 index = 0;
             }
 
-            const SimplePoint& pt = tileItem.point(i);
+            SimplePoint pt = tileItem.point(i);
             index = style->addPoint(pt, z, index, buffer);
         }
-        ++it;
 
         if(isSelect) {
             selectIndex = index;
@@ -598,12 +591,11 @@ VectorGlObject* GlSelectableFeatureLayer::fillPoints(const VectorTile& tile,
     return bufferArray;
 }
 
-VectorGlObject* GlSelectableFeatureLayer::fillLines(const VectorTile& tile,
+VectorGlObject* GlSelectableFeatureLayer::fillLines(VectorTileView& tile,
                                                     float z)
 {
     VectorSelectableGlObject* bufferArray = new VectorSelectableGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
+    VectorTileItemView tileItem;
     unsigned short index = 0;
     GlBuffer* buffer = nullptr;
     GlBuffer* draw = new GlBuffer(GlBuffer::BF_LINE);
@@ -614,15 +606,12 @@ VectorGlObject* GlSelectableFeatureLayer::fillLines(const VectorTile& tile,
     unsigned short drawIndex = 0;
     unsigned short selectIndex = 0;
 
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
+    while(tile.next(tileItem)) {
         if(tileItem.isIdsPresent(m_hideFIDs)) {
-            ++it;
             continue;
         }
 
         if(tileItem.pointCount() < 2) {
-            ++it;
             continue;
         }
 
@@ -644,8 +633,8 @@ VectorGlObject* GlSelectableFeatureLayer::fillLines(const VectorTile& tile,
 
         Normal prevNormal;
         for(size_t i = 0; i < tileItem.pointCount() - 1; ++i) {
-            const SimplePoint& pt1 = tileItem.point(i);
-            const SimplePoint& pt2 = tileItem.point(i + 1);
+            SimplePoint pt1 = tileItem.point(i);
+            SimplePoint pt2 = tileItem.point(i + 1);
             Normal normal = ngsGetNormals(pt1, pt2);
 
             if(i == 0 || i == tileItem.pointCount() - 2) { // Add cap
@@ -737,7 +726,6 @@ VectorGlObject* GlSelectableFeatureLayer::fillLines(const VectorTile& tile,
             index = style->addSegment(pt1, pt2, normal, z, index, buffer);
             prevNormal = normal;
         }
-        ++it;
 
         if(isSelect) {
             selectIndex = index;
@@ -752,12 +740,11 @@ VectorGlObject* GlSelectableFeatureLayer::fillLines(const VectorTile& tile,
     return bufferArray;
 }
 
-VectorGlObject* GlSelectableFeatureLayer::fillPolygons(const VectorTile& tile,
+VectorGlObject* GlSelectableFeatureLayer::fillPolygons(VectorTileView& tile,
                                                        float z)
 {
     VectorSelectableGlObject* bufferArray = new VectorSelectableGlObject;
-    auto items = tile.items();
-    auto it = items.begin();
+    VectorTileItemView tileItem;
     unsigned short fillIndex = 0;
     unsigned short lineIndex = 0;
     GlBuffer* drawFillBuffer = new GlBuffer(GlBuffer::BF_FILL);
@@ -783,19 +770,14 @@ VectorGlObject* GlSelectableFeatureLayer::fillPolygons(const VectorTile& tile,
     unsigned short drawFillIndex = 0;
     unsigned short drawLineIndex = 0;
 
-    while(it != items.end()) {
-        VectorTileItem tileItem = *it;
+    while(tile.next(tileItem)) {
         if(tileItem.isIdsPresent(m_hideFIDs)) {
-            ++it;
             continue;
         }
 
-        auto points = tileItem.points();
-        auto indices = tileItem.indices();
-
-        if(points.size() < 3 || points.size() > GlBuffer::maxIndices() ||
-                points.size() > GlBuffer::maxVertices()) {
-            ++it;
+        if(tileItem.pointCount() < 3 ||
+                tileItem.pointCount() > GlBuffer::maxIndices() ||
+                tileItem.pointCount() > GlBuffer::maxVertices()) {
             continue;
         }
 
@@ -819,7 +801,7 @@ VectorGlObject* GlSelectableFeatureLayer::fillPolygons(const VectorTile& tile,
         }
 
         // Fill polygons
-        if(!fillBuffer->canStoreVertices(points.size() * 3, false)) {
+        if(!fillBuffer->canStoreVertices(tileItem.pointCount() * 3, false)) {
             fillIndex = 0;
             if(isSelect) {
                 bufferArray->addSelectionBuffer(fillBuffer);
@@ -835,7 +817,8 @@ VectorGlObject* GlSelectableFeatureLayer::fillPolygons(const VectorTile& tile,
             }
         }
 
-        for(auto point : points) {
+        for(size_t i = 0; i < tileItem.pointCount(); ++i) {
+            SimplePoint point = tileItem.point(i);
             fillBuffer->addVertex(point.x);
             fillBuffer->addVertex(point.y);
             fillBuffer->addVertex(z);
@@ -843,7 +826,7 @@ VectorGlObject* GlSelectableFeatureLayer::fillPolygons(const VectorTile& tile,
 
         // FIXME: Expected indices should fit to buffer as points can
 //        unsigned short maxFillIndex = 0;
-        for(auto indexPoint : indices) {
+        for(size_t i = 0; i < tileItem.indexCount(); ++i) {
             fillBuffer->addIndex(fillIndex++);
 //            fillBuffer->addIndex(fillIndex + indexPoint);
 //            if(maxFillIndex < indexPoint) {
@@ -857,18 +840,17 @@ VectorGlObject* GlSelectableFeatureLayer::fillPolygons(const VectorTile& tile,
         // FIXME: May be more styles with borders
         if(EQUAL(style->name(), "simpleFillBordered")) {
 
-        auto borders = (*it).borderIndices();
-        for(auto border : borders) {
+        for(size_t ring = 0; ring < tileItem.borderCount(); ++ring) {
             Normal prevNormal;
             Normal firstNormal;
             bool firstNormalSet = false;
-            for(size_t i = 0; i < border.size() - 1; ++i) {
-                auto borderIndex = border[i];
-                auto borderIndex1 = border[i + 1];
-                Normal normal = ngsGetNormals(points[borderIndex],
-                                              points[borderIndex1]);
+            for(size_t i = 0; i < tileItem.borderSize(ring) - 1; ++i) {
+                auto borderIndex = tileItem.borderIndex(ring, i);
+                auto borderIndex1 = tileItem.borderIndex(ring, i + 1);
+                Normal normal = ngsGetNormals(tileItem.point(borderIndex),
+                                              tileItem.point(borderIndex1));
 
-                if(i == border.size() - 2) {
+                if(i == tileItem.borderSize(ring) - 2) {
                     if(!lineBuffer->canStoreVertices(lineStyle->lineCapVerticesCount(),
                                                      true)) {
                         lineIndex = 0;
@@ -889,7 +871,7 @@ VectorGlObject* GlSelectableFeatureLayer::fillPolygons(const VectorTile& tile,
                     Normal reverseNormal;
                     reverseNormal.x = -normal.x;
                     reverseNormal.y = -normal.y;
-                    lineIndex = lineStyle->addLineJoin(points[borderIndex1],
+                    lineIndex = lineStyle->addLineJoin(tileItem.point(borderIndex1),
                            firstNormal, reverseNormal, z, lineIndex, lineBuffer);
                 }
 
@@ -910,7 +892,7 @@ VectorGlObject* GlSelectableFeatureLayer::fillPolygons(const VectorTile& tile,
                             drawLineIndex = 0;
                         }
                     }
-                    lineIndex = lineStyle->addLineJoin(points[borderIndex],
+                    lineIndex = lineStyle->addLineJoin(tileItem.point(borderIndex),
                                    prevNormal, normal, z, lineIndex, lineBuffer);
                 }
 
@@ -930,8 +912,8 @@ VectorGlObject* GlSelectableFeatureLayer::fillPolygons(const VectorTile& tile,
                     }
                 }
 
-                lineIndex = lineStyle->addSegment(points[borderIndex],
-                                              points[borderIndex1], normal,
+                lineIndex = lineStyle->addSegment(tileItem.point(borderIndex),
+                                              tileItem.point(borderIndex1), normal,
                                               z, lineIndex, lineBuffer);
 
                 prevNormal = normal;
@@ -944,8 +926,6 @@ VectorGlObject* GlSelectableFeatureLayer::fillPolygons(const VectorTile& tile,
         }
         }
 
-        ++it;
-
         if(isSelect) {
             selectLineIndex = lineIndex;
             selectFillIndex = fillIndex;
@@ -995,6 +975,11 @@ bool GlRasterLayer::fill(GlTilePtr tile, float z, bool isLastTry)
         return true;
     }
 
+    // Tile may leave the view while the job waits or runs
+    if(tile->isCancelled()) {
+        return true;
+    }
+
     Envelope rasterExtent = m_raster->extent();
     const Envelope & tileExtent = tile->getExtent();
 
@@ -1133,6 +1118,11 @@ bool GlRasterLayer::fill(GlTilePtr tile, float z, bool isLastTry)
         }
     }
 
+    if(tile->isCancelled()) {
+        CPLFree(pixData);
+        return true;
+    }
+
     GlImage *image = new GlImage;
     image->setImage(pixData, outWidth, outHeight); // NOTE: May be not working NOD
     image->setSmooth(smooth);
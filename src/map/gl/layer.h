@@ -128,9 +128,9 @@ public:
     virtual void setFeatureClass(const FeatureClassPtr &featureClass) override;
 
 protected:
-    virtual VectorGlObject* fillPoints(const VectorTile& tile, float z);
-    virtual VectorGlObject* fillLines(const VectorTile& tile, float z);
-    virtual VectorGlObject* fillPolygons(const VectorTile& tile, float z);
+    virtual VectorGlObject* fillPoints(VectorTileView& tile, float z);
+    virtual VectorGlObject* fillLines(VectorTileView& tile, float z);
+    virtual VectorGlObject* fillPolygons(VectorTileView& tile, float z);
 };
 
 typedef std::array<StylePtr, 3> SelectionStyles;
@@ -151,9 +151,9 @@ public:
     virtual bool drawSelection(GlTilePtr tile);
 
 protected:
-    virtual VectorGlObject* fillPoints(const VectorTile& tile, float z) override;
-    virtual VectorGlObject* fillLines(const VectorTile& tile, float z) override;
-    virtual VectorGlObject* fillPolygons(const VectorTile& tile, float z) override;
+    virtual VectorGlObject* fillPoints(VectorTileView& tile, float z) override;
+    virtual VectorGlObject* fillLines(VectorTileView& tile, float z) override;
+    virtual VectorGlObject* fillPolygons(VectorTileView& tile, float z) override;
 
 protected:
     const SelectionStyles* m_selectionStyles;
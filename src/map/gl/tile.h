@@ -26,6 +26,7 @@
 #include "image.h"
 #include "ds/geometry.h"
 #include "map/matrix.h"
+#include "util/threadpool.h"
 
 namespace ngs {
 
@@ -58,6 +59,8 @@ public:
         return size_t(m_originalTileSize/*m_image.getWidth()*/ * 256.0 / GLTILE_SIZE);
     }
     unsigned short tileSize() const { return  m_tileSize; }
+    void cancel() { m_cancelToken.cancel(); }
+    bool isCancelled() const { return m_cancelToken.isCancelled(); }
 
     static void prepareContext();
 
@@ -81,6 +84,7 @@ protected:
     bool m_filled;
     unsigned short m_tileSize, m_originalTileSize;
     Envelope m_originalEnv;
+    CancelToken m_cancelToken;
 };
 
 typedef std::shared_ptr<GlTile> GlTilePtr;
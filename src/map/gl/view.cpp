@@ -21,6 +21,9 @@
 
 #include "view.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "layer.h"
 #include "style.h"
 #include "map/overlay.h"
@@ -30,6 +33,7 @@
 namespace ngs {
 
 constexpr unsigned char MAX_TRIES = 2;
+constexpr int BUFFER_TILE_PRIORITY = 1 << 24;
 constexpr const char* SELECTION_KEY = "selection";
 
 //------------------------------------------------------------------------------
@@ -41,11 +45,41 @@ public:
     LayerFillData(GlTilePtr tile, LayerPtr layer, float z, bool own) :
         ThreadData(own), m_tile(tile), m_layer(layer), m_zlevel(z) {
     }
+    virtual bool isCancelled() const override { return m_tile->isCancelled(); }
     GlTilePtr m_tile;
     LayerPtr m_layer;
     float m_zlevel;
 };
 
+/**
+ * @brief fillPriority Returns priority of tile fill job. The visible tiles are
+ * filled before the buffer ring, the tiles closer to the viewport center first,
+ * the upper layers of the same tile first.
+ * @param tile Tile to fill
+ * @param viewExtent Current viewport extent
+ * @param layerIndex Layer index from the top
+ * @return Priority value. The lower value is processed first.
+ */
+static int fillPriority(const GlTilePtr& tile, const Envelope& viewExtent,
+                        size_t layerIndex)
+{
+    Envelope env = tile->getExtent();
+    env.move(tile->getTile().crossExtent * DEFAULT_BOUNDS.width(), 0.0);
+    OGRRawPoint tileCenter = env.center();
+    OGRRawPoint viewCenter = viewExtent.center();
+    double distance = std::sqrt(
+                (tileCenter.x - viewCenter.x) * (tileCenter.x - viewCenter.x) +
+                (tileCenter.y - viewCenter.y) * (tileCenter.y - viewCenter.y)) /
+            env.width();
+
+    int priority = static_cast<int>(std::min(distance * 16.0, 65535.0)) * 256 +
+            static_cast<int>(std::min(layerIndex, static_cast<size_t>(255)));
+    if(!env.intersects(viewExtent)) {
+        priority += BUFFER_TILE_PRIORITY;
+    }
+    return priority;
+}
+
 //------------------------------------------------------------------------------
 // GlView
 //------------------------------------------------------------------------------
@@ -67,6 +101,7 @@ void GlView::clearTiles()
 {
     auto it = m_tiles.begin();
     while(it != m_tiles.end()) {
+        (*it)->cancel();
         (*it)->destroy();
         it = m_tiles.erase(it);
     }
@@ -193,10 +228,13 @@ bool GlView::draw(ngsDrawState state, const Progress &progress)
             if(tile->filled())
                 continue;
             float z = 0.0f;
+            size_t layerIndex = 0;
             for (auto layerIt = m_layers.rbegin(); layerIt != m_layers.rend();
                  ++layerIt) {
                 const LayerPtr &layer = *layerIt;
-                m_threadPool.addThreadData(new LayerFillData(tile, layer, z, true));
+                LayerFillData* data = new LayerFillData(tile, layer, z, true);
+                data->setPriority(fillPriority(tile, getExtent(), layerIndex++));
+                m_threadPool.addThreadData(data);
 
                 z += 1000.0f;
             }
@@ -221,6 +259,7 @@ void GlView::invalidate(const Envelope& bounds)
          Envelope env = tile->getExtent();
          env.resize(TILE_RESIZE);
          if(env.intersects(bounds) || env.intersects(m_invalidRegion)) {
+             tile->cancel();
              m_oldTiles.push_back(tile);
              it = m_tiles.erase(it);
 
@@ -234,10 +273,13 @@ void GlView::invalidate(const Envelope& bounds)
     for(GlTilePtr& tile : newTiles) {
         m_tiles.push_back(tile);
         float z = 0.0f;
+        size_t layerIndex = 0;
         for (auto layerIt = m_layers.rbegin(); layerIt != m_layers.rend();
              ++layerIt) {
             const LayerPtr &layer = *layerIt;
-            m_threadPool.addThreadData(new LayerFillData(tile, layer, z, true));
+            LayerFillData* data = new LayerFillData(tile, layer, z, true);
+            data->setPriority(fillPriority(tile, getExtent(), layerIndex++));
+            m_threadPool.addThreadData(data);
             z += 1000.f;
         }
     }
@@ -358,6 +400,8 @@ void GlView::updateTilesList()
         }
 
         if(markToDelete) {
+            // Stop filling the tile out of view
+            (*tileIt)->cancel();
             m_oldTiles.push_back(*tileIt);
             tileIt = m_tiles.erase(tileIt);
         }
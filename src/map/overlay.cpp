@@ -417,9 +417,7 @@ bool EditLayerOverlay::editGeometry(LayerPtr layer, GIntBig featureId)
         return errorMessage(_("Geometry is null"));
     }
 
-    std::set<GIntBig> hideIds;
-    hideIds.insert(m_editFeatureId);
-    featureLayer->setHideIds(hideIds);
+    featureLayer->setHideIds({m_editFeatureId});
 
     OGREnvelope ogrEnv;
     m_geometry->getEnvelope(&ogrEnv);
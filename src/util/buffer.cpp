@@ -145,6 +145,61 @@ Buffer&Buffer::put(GIntBig val)
     return *this;
 }
 
+Buffer&Buffer::put(double val)
+{
+    size_t size = sizeof(double);
+    grow(size);
+
+    std::memcpy(m_data + m_currentPos, &val, size);
+    m_currentPos += size;
+    m_size += size;
+
+    return *this;
+}
+
+Buffer&Buffer::put(const GByte* data, size_t size)
+{
+    grow(size);
+
+    std::memcpy(m_data + m_currentPos, data, size);
+    m_currentPos += size;
+    m_size += size;
+
+    return *this;
+}
+
+Buffer&Buffer::putVarUInt(GUIntBig val)
+{
+    // LEB128: 7 bits per byte, high bit set if more bytes follow
+    grow(10);
+    while(val >= 0x80) {
+        m_data[m_currentPos++] = static_cast<GByte>(val | 0x80);
+        m_size++;
+        val >>= 7;
+    }
+    m_data[m_currentPos++] = static_cast<GByte>(val);
+    m_size++;
+
+    return *this;
+}
+
+Buffer&Buffer::putVarInt(GIntBig val)
+{
+    // Zigzag encoding maps small negative values to small positive ones
+    GUIntBig zigzag = (static_cast<GUIntBig>(val) << 1) ^
+            static_cast<GUIntBig>(val >> 63);
+    return putVarUInt(zigzag);
+}
+
+void Buffer::grow(size_t size)
+{
+    if(static_cast<size_t>(m_mallocSize) < m_currentPos + size) {
+        m_mallocSize = static_cast<int>(m_currentPos + size +
+                                        DEFAULT_BUFFER_SIZE);
+        m_data = static_cast<GByte*>(CPLRealloc(m_data, static_cast<size_t>(m_mallocSize)));
+    }
+}
+
 GUInt32 Buffer::getULong()
 {
     GUInt32 val = 0;
@@ -211,4 +266,36 @@ GIntBig Buffer::getBig()
     return val;
 }
 
+double Buffer::getDouble()
+{
+    double val = 0.0;
+    size_t size = sizeof(double);
+    if(m_currentPos + size > static_cast<size_t>(m_size))
+        return val;
+    std::memcpy(&val, m_data + m_currentPos, size);
+    m_currentPos += size;
+    return val;
+}
+
+GUIntBig Buffer::getVarUInt()
+{
+    GUIntBig val = 0;
+    unsigned char shift = 0;
+    while(m_currentPos < static_cast<size_t>(m_size) && shift < 64) {
+        GByte byte = m_data[m_currentPos++];
+        val |= static_cast<GUIntBig>(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0) {
+            break;
+        }
+        shift += 7;
+    }
+    return val;
+}
+
+GIntBig Buffer::getVarInt()
+{
+    GUIntBig zigzag = getVarUInt();
+    return static_cast<GIntBig>(zigzag >> 1) ^ -static_cast<GIntBig>(zigzag & 1);
+}
+
 }
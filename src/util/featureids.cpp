@@ -0,0 +1,200 @@
+/******************************************************************************
+ * Project: libngstore
+ * Purpose: NextGIS store and visualization support library
+ * Author:  Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2016-2017 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "featureids.h"
+
+#include <cstddef>
+#include <iterator>
+
+namespace ngs {
+
+FeatureIDs::FeatureIDs() :
+    m_id(0),
+    m_single(false)
+{
+
+}
+
+FeatureIDs::FeatureIDs(std::initializer_list<GIntBig> ids) : FeatureIDs()
+{
+    insert(ids.begin(), ids.end());
+}
+
+bool FeatureIDs::insert(GIntBig id)
+{
+    if(empty()) {
+        m_id = id;
+        m_single = true;
+        return true;
+    }
+
+    if(m_single) {
+        if(m_id == id) {
+            return false;
+        }
+        toArray();
+    }
+
+    // Identifiers usually come in ascending order (tile load, FID cursor)
+    if(id > m_ids.back()) {
+        m_ids.push_back(id);
+        return true;
+    }
+
+    auto it = std::lower_bound(m_ids.begin(), m_ids.end(), id);
+    if(*it == id) {
+        return false;
+    }
+    m_ids.insert(it, id);
+    return true;
+}
+
+bool FeatureIDs::erase(GIntBig id)
+{
+    if(m_single) {
+        if(m_id != id) {
+            return false;
+        }
+        m_single = false;
+        return true;
+    }
+
+    auto it = std::lower_bound(m_ids.begin(), m_ids.end(), id);
+    if(it == m_ids.end() || *it != id) {
+        return false;
+    }
+    m_ids.erase(it);
+    if(m_ids.size() == 1) {
+        m_id = m_ids.front();
+        m_single = true;
+        m_ids.clear();
+    }
+    return true;
+}
+
+void FeatureIDs::clear()
+{
+    m_single = false;
+    m_ids.clear();
+}
+
+void FeatureIDs::reserve(size_t size)
+{
+    if(size > 1) {
+        m_ids.reserve(size);
+    }
+}
+
+bool FeatureIDs::contains(GIntBig id) const
+{
+    if(m_single) {
+        return m_id == id;
+    }
+    return std::binary_search(m_ids.begin(), m_ids.end(), id);
+}
+
+bool FeatureIDs::includes(const FeatureIDs& other) const
+{
+    if(other.size() > size()) {
+        return false;
+    }
+    if(other.m_single) {
+        return contains(other.m_id);
+    }
+    return std::includes(begin(), end(), other.begin(), other.end());
+}
+
+bool FeatureIDs::intersects(const FeatureIDs& other) const
+{
+    if(empty() || other.empty()) {
+        return false;
+    }
+    if(m_single) {
+        return other.contains(m_id);
+    }
+    if(other.m_single) {
+        return contains(other.m_id);
+    }
+
+    // Linear merge of two sorted arrays
+    const_iterator first1 = begin(), last1 = end();
+    const_iterator first2 = other.begin(), last2 = other.end();
+    while(first1 != last1 && first2 != last2) {
+        if(*first1 < *first2) {
+            ++first1;
+        }
+        else if(*first2 < *first1) {
+            ++first2;
+        }
+        else {
+            return true;
+        }
+    }
+    return false;
+}
+
+FeatureIDs FeatureIDs::intersection(const FeatureIDs& other) const
+{
+    FeatureIDs out;
+    if(empty() || other.empty()) {
+        return out;
+    }
+    out.m_ids.reserve(std::min(size(), other.size()));
+    std::set_intersection(begin(), end(), other.begin(), other.end(),
+                          std::back_inserter(out.m_ids));
+    out.merge(0);
+    return out;
+}
+
+size_t FeatureIDs::memorySize() const
+{
+    return m_ids.capacity() * sizeof(GIntBig);
+}
+
+bool FeatureIDs::operator==(const FeatureIDs& other) const
+{
+    return size() == other.size() && std::equal(begin(), end(), other.begin());
+}
+
+void FeatureIDs::toArray()
+{
+    if(m_single) {
+        m_ids.push_back(m_id);
+        m_single = false;
+    }
+}
+
+void FeatureIDs::merge(size_t middle)
+{
+    auto mid = m_ids.begin() + static_cast<std::ptrdiff_t>(middle);
+    if(!std::is_sorted(mid, m_ids.end())) {
+        std::sort(mid, m_ids.end());
+    }
+    std::inplace_merge(m_ids.begin(), mid, m_ids.end());
+    m_ids.erase(std::unique(m_ids.begin(), m_ids.end()), m_ids.end());
+
+    if(m_ids.size() == 1) {
+        m_id = m_ids.front();
+        m_single = true;
+        m_ids.clear();
+    }
+}
+
+}
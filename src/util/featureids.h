@@ -0,0 +1,97 @@
+/******************************************************************************
+ * Project: libngstore
+ * Purpose: NextGIS store and visualization support library
+ * Author:  Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2016-2017 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSFEATUREIDS_H
+#define NGSFEATUREIDS_H
+
+#include <algorithm>
+#include <initializer_list>
+#include <vector>
+
+#include "cpl_port.h"
+
+namespace ngs {
+
+/**
+ * @brief The FeatureIDs class Sorted set of feature identifiers. The single
+ * identifier (the most common case for tile items) is stored inline without
+ * heap allocation, more identifiers are stored in the sorted array.
+ */
+class FeatureIDs
+{
+public:
+    typedef const GIntBig* const_iterator;
+
+public:
+    FeatureIDs();
+    FeatureIDs(std::initializer_list<GIntBig> ids);
+    template<class InputIt>
+    FeatureIDs(InputIt first, InputIt last) : FeatureIDs() {
+        insert(first, last);
+    }
+
+    bool insert(GIntBig id);
+    template<class InputIt>
+    void insert(InputIt first, InputIt last);
+    void insert(std::initializer_list<GIntBig> ids) {
+        insert(ids.begin(), ids.end());
+    }
+    bool erase(GIntBig id);
+    void clear();
+    void reserve(size_t size);
+
+    bool contains(GIntBig id) const;
+    bool includes(const FeatureIDs& other) const;
+    bool intersects(const FeatureIDs& other) const;
+    FeatureIDs intersection(const FeatureIDs& other) const;
+    size_t memorySize() const;
+
+    size_t size() const { return m_single ? 1 : m_ids.size(); }
+    bool empty() const { return !m_single && m_ids.empty(); }
+    const_iterator begin() const { return m_single ? &m_id : m_ids.data(); }
+    const_iterator end() const { return begin() + size(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    bool operator==(const FeatureIDs& other) const;
+    bool operator!=(const FeatureIDs& other) const { return !(*this == other); }
+
+private:
+    void toArray();
+    void merge(size_t middle);
+
+private:
+    std::vector<GIntBig> m_ids;
+    GIntBig m_id;
+    bool m_single;
+};
+
+template<class InputIt>
+void FeatureIDs::insert(InputIt first, InputIt last)
+{
+    toArray();
+    size_t middle = m_ids.size();
+    m_ids.insert(m_ids.end(), first, last);
+    merge(middle);
+}
+
+}
+
+#endif // NGSFEATUREIDS_H
@@ -0,0 +1,171 @@
+/******************************************************************************
+ * Project: libngstore
+ * Purpose: NextGIS store and visualization support library
+ * Author:  Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2016-2017 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#include "rwlock.h"
+
+#include <utility>
+#include <vector>
+
+// gdal
+#include "cpl_error.h"
+
+namespace ngs {
+
+// Shared ownership taken by the current thread for each lock
+static thread_local std::vector<std::pair<const ReadWriteLock*, int>>
+    threadSharedLocks;
+
+ReadWriteLock::ReadWriteLock() :
+    m_mutex(CPLCreateMutex()),
+    m_cond(CPLCreateCond()),
+    m_readers(0),
+    m_waitingWriters(0),
+    m_writer(0),
+    m_writerDepth(0),
+    m_contentionCount(0)
+{
+    CPLReleaseMutex(m_mutex);
+}
+
+ReadWriteLock::~ReadWriteLock()
+{
+    CPLDestroyCond(m_cond);
+    CPLDestroyMutex(m_mutex);
+}
+
+int ReadWriteLock::threadSharedCount() const
+{
+    for(const auto& item : threadSharedLocks) {
+        if(item.first == this) {
+            return item.second;
+        }
+    }
+    return 0;
+}
+
+void ReadWriteLock::setThreadSharedCount(int count)
+{
+    for(auto it = threadSharedLocks.begin(); it != threadSharedLocks.end(); ++it) {
+        if(it->first == this) {
+            if(count == 0) {
+                threadSharedLocks.erase(it);
+            }
+            else {
+                it->second = count;
+            }
+            return;
+        }
+    }
+    if(count > 0) {
+        threadSharedLocks.push_back(std::make_pair(this, count));
+    }
+}
+
+bool ReadWriteLock::lock()
+{
+    CPLMutexHolder holder(m_mutex);
+    GIntBig thread = CPLGetPID();
+    if(m_writerDepth > 0 && m_writer == thread) {
+        m_writerDepth++;
+        return true;
+    }
+
+    // Upgrade of shared ownership is not supported: the thread would wait for
+    // own readers and two upgraders deadlock each other
+    if(threadSharedCount() > 0) {
+        CPLError(CE_Failure, CPLE_AppDefined,
+                 "Upgrade of shared lock ownership is not supported");
+        return false;
+    }
+    bool waited = false;
+    m_waitingWriters++;
+    while(m_writerDepth > 0 || m_readers > 0) {
+        waited = true;
+        CPLCondWait(m_cond, m_mutex);
+    }
+    m_waitingWriters--;
+    m_writer = thread;
+    m_writerDepth = 1;
+    if(waited) {
+        m_contentionCount++;
+    }
+    return true;
+}
+
+void ReadWriteLock::unlock()
+{
+    CPLMutexHolder holder(m_mutex);
+    if(m_writerDepth == 0 || m_writer != CPLGetPID()) {
+        CPLError(CE_Failure, CPLE_AppDefined, "Unlock not owned lock");
+        return;
+    }
+    m_writerDepth--;
+    if(m_writerDepth == 0) {
+        m_writer = 0;
+        CPLCondBroadcast(m_cond);
+    }
+}
+
+void ReadWriteLock::lockShared()
+{
+    CPLMutexHolder holder(m_mutex);
+    int ownReaders = threadSharedCount();
+    if(ownReaders > 0) {
+        // Recursive shared ownership must not wait for writers
+        m_readers++;
+        setThreadSharedCount(ownReaders + 1);
+        return;
+    }
+
+    if(m_writerDepth > 0 && m_writer == CPLGetPID()) {
+        m_writerDepth++;
+        return;
+    }
+
+    bool waited = false;
+    while(m_writerDepth > 0 || m_waitingWriters > 0) {
+        waited = true;
+        CPLCondWait(m_cond, m_mutex);
+    }
+    m_readers++;
+    setThreadSharedCount(1);
+    if(waited) {
+        m_contentionCount++;
+    }
+}
+
+void ReadWriteLock::unlockShared()
+{
+    CPLMutexHolder holder(m_mutex);
+    int ownReaders = threadSharedCount();
+    if(ownReaders == 0) {
+        // Taken as the exclusive owner
+        unlock();
+        return;
+    }
+
+    m_readers--;
+    setThreadSharedCount(ownReaders - 1);
+    if(m_readers == 0 || m_waitingWriters > 0) {
+        CPLCondBroadcast(m_cond);
+    }
+}
+
+}
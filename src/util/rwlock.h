@@ -0,0 +1,98 @@
+/******************************************************************************
+ * Project: libngstore
+ * Purpose: NextGIS store and visualization support library
+ * Author:  Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2016-2017 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+#ifndef NGSRWLOCK_H
+#define NGSRWLOCK_H
+
+#include <atomic>
+
+#include "cpl_multiproc.h"
+
+namespace ngs {
+
+/**
+ * @brief The ReadWriteLock class Shared/exclusive lock with writer preference.
+ * Exclusive ownership is recursive and the owner may take shared ownership
+ * too. Shared ownership is recursive per thread and can not be upgraded to
+ * exclusive one, lock() fails in this case. New readers wait while any writer
+ * waits, so writers are not starved by a stream of readers.
+ */
+class ReadWriteLock
+{
+public:
+    ReadWriteLock();
+    ~ReadWriteLock();
+    bool lock();
+    void unlock();
+    void lockShared();
+    void unlockShared();
+    GUIntBig contentionCount() const { return m_contentionCount; }
+    void resetContentionCount() { m_contentionCount = 0; }
+
+private:
+    ReadWriteLock(ReadWriteLock const&) = delete;
+    ReadWriteLock& operator= (ReadWriteLock const&) = delete;
+    int threadSharedCount() const;
+    void setThreadSharedCount(int count);
+
+private:
+    CPLMutex* m_mutex;
+    CPLCond* m_cond;
+    int m_readers;
+    int m_waitingWriters;
+    GIntBig m_writer;
+    int m_writerDepth;
+    std::atomic<GUIntBig> m_contentionCount;
+};
+
+/**
+ * @brief The ReadWriteLockHolder class Holds shared or exclusive ownership of
+ * the lock in the scope.
+ */
+class ReadWriteLockHolder
+{
+public:
+    explicit ReadWriteLockHolder(ReadWriteLock* lock, bool shared = false) :
+        m_lock(lock), m_shared(shared) {
+        if(nullptr != m_lock) {
+            if(m_shared)
+                m_lock->lockShared();
+            else if(!m_lock->lock())
+                m_lock = nullptr;
+        }
+    }
+
+    ~ReadWriteLockHolder() {
+        if(nullptr != m_lock) {
+            if(m_shared)
+                m_lock->unlockShared();
+            else
+                m_lock->unlock();
+        }
+    }
+
+protected:
+    ReadWriteLock* m_lock;
+    bool m_shared;
+};
+
+}
+
+#endif // NGSRWLOCK_H
@@ -20,16 +20,266 @@
  ****************************************************************************/
 #include "threadpool.h"
 
+#include <chrono>
+#include <deque>
+#include <iterator>
+
+// gdal
 #include "cpl_conv.h"
 
+#include "options.h"
+
 namespace ngs {
 
+// Pool worker task yields after this number of jobs
+constexpr size_t POOL_JOBS_PER_TASK = 16;
+
+//------------------------------------------------------------------------------
+// TaskState
+//------------------------------------------------------------------------------
+class TaskState
+{
+public:
+    TaskState() : m_mutex(CPLCreateMutex()), m_cond(CPLCreateCond()),
+        m_done(false) {
+        CPLReleaseMutex(m_mutex);
+    }
+    ~TaskState() {
+        CPLDestroyCond(m_cond);
+        CPLDestroyMutex(m_mutex);
+    }
+    bool isDone() {
+        CPLMutexHolder holder(m_mutex, 1000.0);
+        return m_done;
+    }
+    void finish() {
+        CPLMutexHolder holder(m_mutex, 1000.0);
+        m_done = true;
+        CPLCondBroadcast(m_cond);
+    }
+    void wait() {
+        CPLMutexHolder holder(m_mutex, 1000.0);
+        while(!m_done) {
+            CPLCondWait(m_cond, m_mutex);
+        }
+    }
+
+private:
+    CPLMutex* m_mutex;
+    CPLCond* m_cond;
+    bool m_done;
+};
+
+//------------------------------------------------------------------------------
+// TaskHandle
+//------------------------------------------------------------------------------
+bool TaskHandle::isDone() const
+{
+    return !m_state || m_state->isDone();
+}
+
+void TaskHandle::wait() const
+{
+    if(!m_state) {
+        return;
+    }
+
+    // Worker must not block while the task may wait in the queue of this
+    // worker. If no task is queued, the task is already running on other worker.
+    if(Executor::isWorkerThread()) {
+        while(!m_state->isDone()) {
+            if(!Executor::instance().runPendingTask()) {
+                break;
+            }
+        }
+    }
+    m_state->wait();
+}
+
+//------------------------------------------------------------------------------
+// Executor
+//------------------------------------------------------------------------------
+static thread_local int currentWorker = -1;
+
+struct Executor::Worker {
+    Executor* executor;
+    int index;
+    CPLMutex* mutex;
+    std::deque<Task> tasks;
+    CPLJoinableThread* thread;
+};
+
+Executor::Executor() :
+    m_workerCount(0),
+    m_nextWorker(0),
+    m_pendingCount(0),
+    m_mutex(CPLCreateMutex()),
+    m_cond(CPLCreateCond()),
+    m_stop(false)
+{
+    CPLReleaseMutex(m_mutex);
+    m_workers.fill(nullptr);
+    reserveWorkers(getNumberThreads());
+}
+
+Executor::~Executor()
+{
+    CPLAcquireMutex(m_mutex, 1000.0);
+    m_stop = true;
+    CPLCondBroadcast(m_cond);
+    CPLReleaseMutex(m_mutex);
+
+    // Current tasks are completed, not started tasks are dropped.
+    for(unsigned char i = 0; i < m_workerCount; ++i) {
+        CPLJoinThread(m_workers[i]->thread);
+    }
+    for(unsigned char i = 0; i < m_workerCount; ++i) {
+        CPLDestroyMutex(m_workers[i]->mutex);
+        delete m_workers[i];
+    }
+    CPLDestroyCond(m_cond);
+    CPLDestroyMutex(m_mutex);
+}
+
+Executor& Executor::instance()
+{
+    static Executor executor;
+    return executor;
+}
+
+TaskHandle Executor::submit(const Task& task, bool yield)
+{
+    TaskHandle handle;
+    handle.m_state = std::make_shared<TaskState>();
+    std::shared_ptr<TaskState> state = handle.m_state;
+
+    // Task added from worker goes to own deque for locality, others are spread
+    // round robin. Yielded task is queued before the tasks of the worker, so
+    // they run first.
+    int index = currentWorker;
+    if(index < 0) {
+        index = static_cast<int>(m_nextWorker++ % m_workerCount);
+    }
+
+    m_pendingCount++;
+    Worker* worker = m_workers[static_cast<size_t>(index)];
+    CPLAcquireMutex(worker->mutex, 1000.0);
+    Task wrapper = [task, state]() {
+        task();
+        state->finish();
+    };
+    if(yield) {
+        worker->tasks.push_front(wrapper);
+    }
+    else {
+        worker->tasks.push_back(wrapper);
+    }
+    CPLReleaseMutex(worker->mutex);
+
+    CPLMutexHolder holder(m_mutex, 1000.0);
+    CPLCondSignal(m_cond);
+    return handle;
+}
+
+void Executor::reserveWorkers(unsigned char count)
+{
+    CPLMutexHolder holder(m_mutex, 1000.0);
+    if(count > MAX_EXECUTOR_WORKER_COUNT) {
+        count = MAX_EXECUTOR_WORKER_COUNT;
+    }
+    if(count < 1) {
+        count = 1;
+    }
+
+    while(m_workerCount < count) {
+        Worker* worker = new Worker;
+        worker->executor = this;
+        worker->index = m_workerCount;
+        worker->mutex = CPLCreateMutex();
+        CPLReleaseMutex(worker->mutex);
+        m_workers[m_workerCount] = worker;
+        worker->thread = CPLCreateJoinableThread(workerFunction, worker);
+        m_workerCount++;
+    }
+}
+
+bool Executor::runPendingTask()
+{
+    Task task;
+    if(!popTask(currentWorker, task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+bool Executor::isWorkerThread()
+{
+    return currentWorker >= 0;
+}
+
+bool Executor::popTask(int worker, Executor::Task& task)
+{
+    unsigned char count = m_workerCount;
+    if(worker >= 0) {
+        Worker* own = m_workers[static_cast<size_t>(worker)];
+        CPLMutexHolder holder(own->mutex, 1000.0);
+        if(!own->tasks.empty()) {
+            task = std::move(own->tasks.back());
+            own->tasks.pop_back();
+            m_pendingCount--;
+            return true;
+        }
+    }
+
+    // Steal the oldest task from other workers
+    for(unsigned char i = 1; i <= count; ++i) {
+        size_t index = static_cast<size_t>(worker + i) % count;
+        Worker* other = m_workers[index];
+        CPLMutexHolder holder(other->mutex, 1000.0);
+        if(!other->tasks.empty()) {
+            task = std::move(other->tasks.front());
+            other->tasks.pop_front();
+            m_pendingCount--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Executor::workerFunction(void* workerData)
+{
+    Worker* worker = static_cast<Worker*>(workerData);
+    Executor* executor = worker->executor;
+    currentWorker = worker->index;
+
+    Task task;
+    while(true) {
+        if(executor->popTask(worker->index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        CPLAcquireMutex(executor->m_mutex, 1000.0);
+        while(executor->m_pendingCount == 0 && !executor->m_stop) {
+            CPLCondWait(executor->m_cond, executor->m_mutex);
+        }
+        bool stop = executor->m_stop;
+        CPLReleaseMutex(executor->m_mutex);
+        if(stop) {
+            return;
+        }
+    }
+}
+
 
 //------------------------------------------------------------------------------
 // ThreadData
 //------------------------------------------------------------------------------
 ThreadData::ThreadData(bool own) : m_own(own),
-    m_tries(0)
+    m_tries(0),
+    m_priority(0)
 {
 
 }
@@ -40,12 +290,16 @@ ThreadData::ThreadData(bool own) : m_own(own),
 ThreadPool::ThreadPool() :
     m_dataMutex(CPLCreateMutex()),
     m_threadMutex(CPLCreateMutex()),
+    m_completeCond(CPLCreateCond()),
     m_function(nullptr),
     m_maxThreadCount(1),
     m_threadCount(0),
     m_tries(3),
     m_stopOnFirstFail(false),
-    m_failed(false)
+    m_failed(false),
+    m_completeCount(0),
+    m_progressInterval(CPLAtofM(CPLGetConfigOption("NGS_PROGRESS_INTERVAL",
+                                                   "0.1")))
 {
     CPLReleaseMutex(m_dataMutex);
     CPLReleaseMutex(m_threadMutex);
@@ -54,6 +308,23 @@ ThreadPool::ThreadPool() :
 ThreadPool::~ThreadPool()
 {
     clearThreadData();
+
+    // Wait workers still referenced this pool. Worker may be continued by a
+    // new task, so wait until no task is left.
+    while(true) {
+        CPLAcquireMutex(m_threadMutex, 19.5);
+        std::list<TaskHandle> workers;
+        workers.swap(m_workers);
+        CPLReleaseMutex(m_threadMutex);
+        if(workers.empty()) {
+            break;
+        }
+        for(const TaskHandle& worker : workers) {
+            worker.wait();
+        }
+    }
+
+    CPLDestroyCond(m_completeCond);
     CPLDestroyMutex(m_dataMutex);
     CPLDestroyMutex(m_threadMutex);
 }
@@ -65,17 +336,32 @@ void ThreadPool::init(unsigned char numThreads, poolThreadFunction function,
     m_function = function;
     m_tries = tries;
     m_stopOnFirstFail = stopOnFirstFail;
+    Executor::instance().reserveWorkers(numThreads);
 }
 
 void ThreadPool::addThreadData(ThreadData *data)
 {
     CPLAcquireMutex(m_dataMutex, 15.5);
-    m_threadData.push_back(data);
+    insertThreadData(data);
     CPLReleaseMutex(m_dataMutex);
 
     newWorker();
 }
 
+void ThreadPool::insertThreadData(ThreadData* data)
+{
+    // Lower priority value is processed first, equal priorities keep the order
+    auto it = m_threadData.end();
+    while(it != m_threadData.begin()) {
+        auto prev = std::prev(it);
+        if((*prev)->priority() <= data->priority()) {
+            break;
+        }
+        it = prev;
+    }
+    m_threadData.insert(it, data);
+}
+
 void ThreadPool::clearThreadData()
 {
     CPLMutexHolder holder(m_dataMutex, 25.5);
@@ -87,29 +373,64 @@ void ThreadPool::clearThreadData()
     m_threadData.clear();
 }
 
-void ThreadPool::waitComplete(const Progress &progress)
+bool ThreadPool::waitComplete(const Progress &progress)
 {
     bool complete = false;
+    bool canceled = false;
     size_t currentDataCount = dataCount();
+    auto lastProgress = std::chrono::steady_clock::now();
+    bool firstProgress = true;
     while(true) {
-
-        CPLAcquireMutex(m_threadMutex, 7.0);
-        complete = m_threadCount <= 0;
-        double completePercent = double(dataCount()) / currentDataCount;
-        if(!progress.onProgress(COD_IN_PROCESS, 1.0 - completePercent,
-                                _("Working..."))) {
-            clearThreadData();
+        // Waiting worker executes queued tasks instead of blocking them
+        if(Executor::isWorkerThread() &&
+                Executor::instance().runPendingTask()) {
+            CPLAcquireMutex(m_threadMutex, 7.0);
+        }
+        else {
+            // Wake up on each job completion
+            CPLAcquireMutex(m_threadMutex, 7.0);
+            size_t completeCount = m_completeCount;
+            while(m_threadCount > 0 && completeCount == m_completeCount) {
+                CPLCondWait(m_completeCond, m_threadMutex);
+            }
         }
+        complete = m_threadCount <= 0;
         CPLReleaseMutex(m_threadMutex);
 
-        if(complete) {
-            return;
+        // Progress is throttled, but the final state is always reported
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - lastProgress;
+        if(complete || firstProgress ||
+                elapsed.count() >= m_progressInterval) {
+            firstProgress = false;
+            lastProgress = now;
+            double completePercent = currentDataCount == 0 ? 0.0 :
+                        double(dataCount()) / currentDataCount;
+            if(!progress.onProgress(COD_IN_PROCESS, 1.0 - completePercent,
+                                    _("Working..."))) {
+                clearThreadData();
+                canceled = true;
+            }
         }
 
-        CPLSleep(0.55);
+        if(complete) {
+            return !canceled;
+        }
     }
 }
 
+void ThreadPool::setProgressInterval(double seconds)
+{
+    m_progressInterval = seconds;
+}
+
+void ThreadPool::jobComplete()
+{
+    CPLMutexHolder holder(m_threadMutex, 19.5);
+    m_completeCount++;
+    CPLCondBroadcast(m_completeCond);
+}
+
 bool ThreadPool::process()
 {
     CPLAcquireMutex(m_dataMutex, 19.5);
@@ -124,15 +445,25 @@ bool ThreadPool::process()
         return false; // Should never happened.
     }
 
+    if(data->isCancelled()) {
+        if(data->isOwn()) {
+            delete data;
+        }
+        jobComplete();
+        return true;
+    }
+
     if(m_function(data)) {
         if(data->isOwn()) {
             delete data;
         }
+        jobComplete();
     }
     else if(data->tries() > m_tries) {
         if(data->isOwn()) {
             delete data;
         }
+        jobComplete();
         if(m_stopOnFirstFail) {
             clearThreadData();
             m_failed = true;
@@ -142,7 +473,7 @@ bool ThreadPool::process()
     else {
         data->increaseTries();
         CPLMutexHolder holder(m_dataMutex, 19.5);
-        m_threadData.push_back(data);
+        insertThreadData(data);
     }
 
     return true;
@@ -150,16 +481,19 @@ bool ThreadPool::process()
 
 void ThreadPool::finished()
 {
-    CPLAcquireMutex(m_threadMutex, 19.5);
+    // Data may be added after this worker found the queue empty, so the
+    // replacement worker is started before waiting thread is woken up.
+    CPLMutexHolder threadHolder(m_threadMutex, 19.5);
     m_threadCount--;
-    CPLReleaseMutex(m_threadMutex);
 
-    CPLMutexHolder holder(m_dataMutex, 19.5);
-    if(m_threadData.empty()) {
-        return;
+    CPLAcquireMutex(m_dataMutex, 19.5);
+    bool hasData = !m_threadData.empty();
+    CPLReleaseMutex(m_dataMutex);
+    if(hasData) {
+        newWorker();
     }
 
-    newWorker();
+    CPLCondBroadcast(m_completeCond);
 }
 
 void ThreadPool::newWorker()
@@ -168,18 +502,45 @@ void ThreadPool::newWorker()
     if(m_threadCount == m_maxThreadCount) {
         return;
     }
-    CPLCreateThread(threadFunction, this);
+
+    // Drop handles of finished workers
+    for(auto it = m_workers.begin(); it != m_workers.end();) {
+        if(it->isDone()) {
+            it = m_workers.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
     m_threadCount++;
+    m_workers.push_back(Executor::instance().submit([this]() {
+        threadFunction(this);
+    }));
+}
+
+void ThreadPool::continueWorker()
+{
+    CPLMutexHolder holder(m_threadMutex, 19.5);
+    m_workers.push_back(Executor::instance().submit([this]() {
+        threadFunction(this);
+    }, true));
 }
 
 void ThreadPool::threadFunction(void *threadData)
 {
     ThreadPool *pool = static_cast<ThreadPool*>(threadData);
     if(nullptr != pool) {
-        while(pool->process()) {
-            //CPLSleep(0.125);
+        // Long pool must not hold executor workers, so the worker is continued
+        // by a new task after a chunk of jobs and other tasks (i.e. map view
+        // fill) run in between.
+        for(size_t i = 0; i < POOL_JOBS_PER_TASK; ++i) {
+            if(!pool->process()) {
+                pool->finished();
+                return;
+            }
         }
-        pool->finished();
+        pool->continueWorker();
     }
 }
 
@@ -21,7 +21,12 @@
 #ifndef NGSTHREADPOOL_H
 #define NGSTHREADPOOL_H
 
+#include <array>
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <list>
+#include <memory>
 
 #include "cpl_multiproc.h"
 
@@ -29,6 +34,21 @@
 
 namespace ngs {
 
+/**
+ * @brief The CancelToken class Cooperative cancellation flag. The copies of
+ * token share the same flag.
+ */
+class CancelToken
+{
+public:
+    CancelToken() : m_cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+    void cancel() { *m_cancelled = true; }
+    bool isCancelled() const { return *m_cancelled; }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+};
+
 /**
  * @brief The ThreadData class Data for thread
  */
@@ -40,16 +60,159 @@ public:
     bool isOwn() const { return m_own; }
     void increaseTries() { m_tries++; }
     unsigned char tries() const { return m_tries; }
+    int priority() const { return m_priority; }
+    void setPriority(int priority) { m_priority = priority; }
+    virtual bool isCancelled() const { return false; }
 
 protected:
     bool m_own;
     unsigned char m_tries;
+    int m_priority;
+};
+
+
+
+/**
+ * @brief The BoundedQueue class Blocking queue of limited size to connect
+ * pipeline stages running in own threads. Push waits while the queue is full,
+ * pop waits while it is empty. The closed queue does not accept new items and
+ * wakes up all waiting threads.
+ */
+template<class T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) :
+        m_mutex(CPLCreateMutex()),
+        m_cond(CPLCreateCond()),
+        m_capacity(capacity > 0 ? capacity : 1),
+        m_closed(false) {
+        CPLReleaseMutex(m_mutex);
+    }
+
+    ~BoundedQueue() {
+        CPLDestroyCond(m_cond);
+        CPLDestroyMutex(m_mutex);
+    }
+
+    /**
+     * @brief push Add item to the queue. Returns false if the queue is closed.
+     */
+    bool push(T item) {
+        CPLMutexHolder holder(m_mutex);
+        while(m_items.size() >= m_capacity && !m_closed) {
+            CPLCondWait(m_cond, m_mutex);
+        }
+        if(m_closed) {
+            return false;
+        }
+        m_items.push_back(std::move(item));
+        CPLCondBroadcast(m_cond);
+        return true;
+    }
+
+    /**
+     * @brief pop Take the oldest item from the queue. Returns false if the
+     * queue is closed and empty.
+     */
+    bool pop(T& item) {
+        CPLMutexHolder holder(m_mutex);
+        while(m_items.empty() && !m_closed) {
+            CPLCondWait(m_cond, m_mutex);
+        }
+        if(m_items.empty()) {
+            return false;
+        }
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        CPLCondBroadcast(m_cond);
+        return true;
+    }
+
+    void close() {
+        CPLMutexHolder holder(m_mutex);
+        m_closed = true;
+        CPLCondBroadcast(m_cond);
+    }
+
+private:
+    BoundedQueue(BoundedQueue const&) = delete;
+    BoundedQueue& operator= (BoundedQueue const&) = delete;
+
+private:
+    CPLMutex* m_mutex;
+    CPLCond* m_cond;
+    std::deque<T> m_items;
+    size_t m_capacity;
+    bool m_closed;
 };
 
+constexpr unsigned char MAX_EXECUTOR_WORKER_COUNT = 128;
 
+class TaskState;
+
+/**
+ * @brief The TaskHandle class Handle of the task submitted to executor
+ */
+class TaskHandle
+{
+    friend class Executor;
+public:
+    TaskHandle() = default;
+    bool isValid() const { return m_state != nullptr; }
+    bool isDone() const;
+    void wait() const;
+
+private:
+    std::shared_ptr<TaskState> m_state;
+};
+
+/**
+ * @brief The Executor class Process wide set of persistent worker threads.
+ * Each worker has own task deque. The worker takes tasks from the back of own
+ * deque and steals from the front of other deques if own is empty.
+ */
+class Executor
+{
+public:
+    typedef std::function<void()> Task;
+
+public:
+    static Executor& instance();
+    TaskHandle submit(const Task& task, bool yield = false);
+    void reserveWorkers(unsigned char count);
+    unsigned char workerCount() const { return m_workerCount; }
+    bool runPendingTask();
+
+    // static
+    static bool isWorkerThread();
+
+private:
+    Executor();
+    ~Executor();
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+    bool popTask(int worker, Task& task);
+
+    // static
+    static void workerFunction(void* workerData);
+
+private:
+    struct Worker;
+    std::array<Worker*, MAX_EXECUTOR_WORKER_COUNT> m_workers;
+    std::atomic<unsigned char> m_workerCount;
+    std::atomic<size_t> m_nextWorker;
+    std::atomic<size_t> m_pendingCount;
+    CPLMutex* m_mutex;
+    CPLCond* m_cond;
+    bool m_stop;
+};
 
 /**
- * @brief The ThreadPool class Pool of threads simultaniously executed
+ * @brief The ThreadPool class Pool of jobs simultaniously executed. The jobs
+ * are executed by the process wide executor, no more than maximum worker
+ * count at once. Each worker task runs a chunk of jobs, so pools share the
+ * executor workers.
  */
 class ThreadPool
 {
@@ -63,26 +226,38 @@ public:
     void clearThreadData();
     unsigned char currentWorkerCount() const { return m_threadCount; }
     unsigned char maxWorkerCount() const { return m_maxThreadCount; }
-    void waitComplete(const Progress &progress);
+    /**
+     * @brief waitComplete Wait until all jobs are processed. Returns false if
+     * canceled by progress, not started jobs are dropped in this case.
+     */
+    bool waitComplete(const Progress &progress);
+    void setProgressInterval(double seconds);
     size_t dataCount() const { return m_threadData.size(); }
     bool isFailed() const { return m_failed; }
 
 protected:
     bool process();
     void finished();
+    void insertThreadData(ThreadData* data);
+    void jobComplete();
     void newWorker();
+    void continueWorker();
 
     // static
     static void threadFunction(void *threadData);
 
 protected:
     std::list<ThreadData*> m_threadData;
+    std::list<TaskHandle> m_workers;
     CPLMutex *m_dataMutex, *m_threadMutex;
+    CPLCond* m_completeCond;
     poolThreadFunction m_function;
     unsigned char m_maxThreadCount, m_threadCount;
     unsigned char m_tries;
     bool m_stopOnFirstFail;
     bool m_failed;
+    size_t m_completeCount;
+    double m_progressInterval;
 };
 
 }
@@ -0,0 +1,177 @@
+/******************************************************************************
+ * Project:  libngstore
+ * Purpose:  NextGIS store and visualization support library
+ * Author: Dmitry Baryshnikov, dmitry.baryshnikov@nextgis.com
+ ******************************************************************************
+ *   Copyright (c) 2016-2017 NextGIS, <info@nextgis.com>
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************/
+
+#include "test.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// gdal
+#include "cpl_string.h"
+
+#include "ds/featureclass.h"
+#include "ds/geometry.h"
+#include "ds/simpledataset.h"
+#include "map/maptransform.h"
+#include "ngstore/api.h"
+
+int ngsBenchmarkProgressFunc(enum ngsCode /*status*/,
+                             double /*complete*/, const char* /*message*/,
+                             void* /*progressArguments*/) {
+    return 1;
+}
+
+TEST(BenchmarkTest, TestCreateVectorOverviewsScaling) {
+    char** options = nullptr;
+    options = ngsAddNameValue(options, "DEBUG_MODE", "ON");
+    options = ngsAddNameValue(options, "SETTINGS_DIR",
+                              ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                              nullptr));
+    EXPECT_EQ(ngsInit(options), COD_SUCCESS);
+    ngsListFree(options);
+
+    CPLString catalogPath = ngsCatalogPathFromSystem(ngsGetCurrentDirectory());
+    CPLString cpdShapePath = catalogPath + "/tmp/bld.shp";
+    CatalogObjectH cpdShape = ngsCatalogObjectGet(cpdShapePath);
+    if(nullptr == cpdShape) {
+        // Copy bld.shp to tmp folder
+        CatalogObjectH store = ngsCatalogObjectGet(catalogPath + "/tmp");
+        CatalogObjectH shape = ngsCatalogObjectGet(catalogPath + "/data/bld.shp");
+        ASSERT_EQ(ngsCatalogObjectCopy(shape, store, nullptr,
+                                       ngsBenchmarkProgressFunc, nullptr),
+                  COD_SUCCESS);
+        cpdShape = ngsCatalogObjectGet(cpdShapePath);
+    }
+    ASSERT_NE(cpdShape, nullptr);
+
+    options = nullptr;
+    options = ngsAddNameValue(options, "FORCE", "ON");
+    options = ngsAddNameValue(options, "ZOOM_LEVELS",
+                              "0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18");
+
+    // Benchmark overviews creation in one thread and in all CPU threads
+    const char* threadCounts[] = {"1", "2", "4", "ALL_CPUS"};
+    for(const char* threadCount : threadCounts) {
+        CPLSetConfigOption("GDAL_NUM_THREADS", threadCount);
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(ngsFeatureClassCreateOverviews(cpdShape, options,
+                              ngsBenchmarkProgressFunc, nullptr), COD_SUCCESS);
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start);
+        std::cout << "Create overviews with GDAL_NUM_THREADS=" << threadCount
+                  << ": " << duration.count() << " ms\n";
+    }
+
+    // Benchmark bottom up pyramid derivation
+    options = ngsAddNameValue(options, "BOTTOM_UP", "ON");
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(ngsFeatureClassCreateOverviews(cpdShape, options,
+                          ngsBenchmarkProgressFunc, nullptr), COD_SUCCESS);
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+    std::cout << "Create overviews bottom up with GDAL_NUM_THREADS=ALL_CPUS: "
+              << duration.count() << " ms\n";
+
+    CPLSetConfigOption("GDAL_NUM_THREADS", nullptr);
+    ngsListFree(options);
+
+    ngsUnInit();
+}
+
+TEST(BenchmarkTest, TestVectorTileFormat) {
+    char** options = nullptr;
+    options = ngsAddNameValue(options, "DEBUG_MODE", "ON");
+    options = ngsAddNameValue(options, "SETTINGS_DIR",
+                              ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                              nullptr));
+    EXPECT_EQ(ngsInit(options), COD_SUCCESS);
+    ngsListFree(options);
+
+    CPLString catalogPath = ngsCatalogPathFromSystem(ngsGetCurrentDirectory());
+    const char* shapePaths[] = {"/data/bld.shp",
+                                "/data/railway.zip/railway-line.shp"};
+    const unsigned char zooms[] = {12, 15};
+    const int decodeRounds = 10;
+    for(const char* shapePath : shapePaths) {
+        CatalogObjectH shape = ngsCatalogObjectGet(catalogPath + shapePath);
+        ASSERT_NE(shape, nullptr);
+        ngs::SimpleDataset* dataset = dynamic_cast<ngs::SimpleDataset*>(
+                    static_cast<ngs::Object*>(shape));
+        ASSERT_NE(dataset, nullptr);
+        dataset->hasChildren();
+        ngs::FeatureClass* featureClass = ngsDynamicCast(ngs::FeatureClass,
+                                                     dataset->internalObject());
+        ASSERT_NE(featureClass, nullptr);
+
+        for(unsigned char zoom : zooms) {
+            // Encode the same tiles as stored in overviews table in v1 and v2
+            std::vector<ngs::BufferPtr> v1Buffers, v2Buffers;
+            size_t v1Size = 0, v2Size = 0, v2DeflateSize = 0;
+            auto items = ngs::MapTransform::getTilesForExtent(
+                        featureClass->extent(), zoom, false, true);
+            for(const auto& item : items) {
+                ngs::VectorTile vtile = featureClass->getTile(item.tile,
+                                                              item.env);
+                if(vtile.empty()) {
+                    continue;
+                }
+                v1Buffers.push_back(vtile.save());
+                v2Buffers.push_back(vtile.save(item.env, false));
+                v1Size += static_cast<size_t>(v1Buffers.back()->size());
+                v2Size += static_cast<size_t>(v2Buffers.back()->size());
+                v2DeflateSize += static_cast<size_t>(
+                            vtile.save(item.env, true)->size());
+            }
+            ASSERT_FALSE(v1Buffers.empty());
+            EXPECT_LT(v2Size, v1Size);
+
+            // Decode as getTileInternal does
+            auto decode = [&](const std::vector<ngs::BufferPtr>& buffers)
+                    -> GIntBig {
+                auto start = std::chrono::steady_clock::now();
+                for(int i = 0; i < decodeRounds; ++i) {
+                    for(const ngs::BufferPtr& buffer : buffers) {
+                        ngs::VectorTile vtile;
+                        buffer->seek(0);
+                        EXPECT_TRUE(vtile.load(*buffer.get()));
+                    }
+                }
+                return static_cast<GIntBig>(
+                            std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::steady_clock::now() - start).count());
+            };
+            GIntBig v1Time = decode(v1Buffers);
+            GIntBig v2Time = decode(v2Buffers);
+
+            std::cout << shapePath << " zoom " << static_cast<int>(zoom)
+                      << ", " << v1Buffers.size() << " tiles: v1 " << v1Size
+                      << " bytes, v2 " << v2Size << " bytes ("
+                      << static_cast<double>(v1Size) / v2Size
+                      << "x), v2 deflate " << v2DeflateSize << " bytes ("
+                      << static_cast<double>(v1Size) / v2DeflateSize
+                      << "x); decode x" << decodeRounds << ": v1 " << v1Time
+                      << " ms, v2 " << v2Time << " ms\n";
+        }
+    }
+
+    ngsUnInit();
+}
@@ -21,6 +21,10 @@
 
 #include "test.h"
 
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
 #include "cpl_conv.h"
 
 #include "ds/featureclass.h"
@@ -95,7 +99,7 @@ TEST(GlTests, TestTileBufferSaveLoad) {
     EXPECT_FLOAT_EQ(pt0.x, 12345.6f);
     EXPECT_FLOAT_EQ(pt0.y, 65432.1f);
 
-    std::set<GIntBig> idset1;
+    ngs::FeatureIDs idset1;
     idset1.insert(777);
     idset1.insert(888);
     EXPECT_EQ(vitem3.isIdsPresent(idset1), true);
@@ -107,11 +111,385 @@ TEST(GlTests, TestTileBufferSaveLoad) {
     EXPECT_FLOAT_EQ(pt1.x, 23456.7f);
     EXPECT_FLOAT_EQ(pt1.y, 76543.2f);
 
-    std::set<GIntBig> idset2;
+    ngs::FeatureIDs idset2;
     idset2.insert(555);
     EXPECT_EQ(vitem4.isIdsPresent(idset2), true);
 }
 
+TEST(GlTests, TestTileBufferSaveLoadV2) {
+    ngs::Envelope extent(10000.0, 60000.0, 30000.0, 80000.0);
+    double quantum = extent.width() / 8192;
+
+    ngs::VectorTile vtile0;
+    for(GIntBig i = 0; i < 100; ++i) {
+        ngs::VectorTileItem vitem;
+        for(int j = 0; j < 10; ++j) {
+            vitem.addPoint({12345.6f + i * 10 + j, 65432.1f + i * 10 - j});
+            vitem.addIndex(static_cast<unsigned short>(j));
+        }
+        vitem.addId(i * 3);
+        vitem.setValid(true);
+        vtile0.add(vitem);
+    }
+
+    ngs::BufferPtr buffer1 = vtile0.save();
+    for(bool compress : {false, true}) {
+        ngs::BufferPtr buffer2 = vtile0.save(extent, compress);
+        EXPECT_LT(buffer2->size() * 3, buffer1->size());
+
+        ngs::VectorTile vtile1;
+        buffer2->seek(0);
+        vtile1.load(*buffer2.get());
+
+        auto items = vtile1.items();
+        ASSERT_EQ(items.size(), 100);
+        for(GIntBig i = 0; i < 100; ++i) {
+            const ngs::VectorTileItem& vitem = items[static_cast<size_t>(i)];
+            ASSERT_EQ(vitem.pointCount(), 10);
+            for(int j = 0; j < 10; ++j) {
+                EXPECT_NEAR(vitem.point(static_cast<size_t>(j)).x,
+                            12345.6f + i * 10 + j, quantum);
+                EXPECT_NEAR(vitem.point(static_cast<size_t>(j)).y,
+                            65432.1f + i * 10 - j, quantum);
+                EXPECT_EQ(vitem.indices()[static_cast<size_t>(j)], j);
+            }
+            ngs::FeatureIDs ids;
+            ids.insert(i * 3);
+            EXPECT_EQ(vitem.isIdsPresent(ids), true);
+        }
+    }
+}
+
+TEST(GlTests, TestTileBufferView) {
+    ngs::Envelope extent(10000.0, 60000.0, 30000.0, 80000.0);
+    double quantum = extent.width() / 8192;
+
+    ngs::VectorTile vtile0;
+    for(GIntBig i = 0; i < 50; ++i) {
+        ngs::VectorTileItem vitem;
+        for(int j = 0; j < 5; ++j) {
+            vitem.addPoint({12345.6f + i * 10 + j, 65432.1f + i * 10 - j});
+            vitem.addIndex(static_cast<unsigned short>(j));
+            vitem.addBorderIndex(0, static_cast<unsigned short>(j));
+        }
+        vitem.addBorderIndex(1, 4);
+        vitem.addId(i);
+        vitem.addId(i + 100);
+        vitem.setValid(true);
+        vtile0.add(vitem);
+    }
+
+    std::vector<ngs::BufferPtr> buffers;
+    buffers.push_back(vtile0.save());
+    buffers.push_back(vtile0.save(extent, false));
+    buffers.push_back(vtile0.save(extent, true));
+    for(const ngs::BufferPtr& buffer : buffers) {
+        ngs::VectorTileView view;
+        ASSERT_EQ(view.load(buffer), true);
+        EXPECT_EQ(view.empty(), false);
+
+        ngs::VectorTileItemView vitem;
+        GIntBig i = 0;
+        while(view.next(vitem)) {
+            ASSERT_EQ(vitem.pointCount(), 5);
+            ASSERT_EQ(vitem.indexCount(), 5);
+            for(size_t j = 0; j < 5; ++j) {
+                EXPECT_NEAR(vitem.point(j).x, 12345.6f + i * 10 + j, quantum);
+                EXPECT_NEAR(vitem.point(j).y, 65432.1f + i * 10 - j, quantum);
+                EXPECT_EQ(vitem.index(j), j);
+            }
+            ASSERT_EQ(vitem.borderCount(), 2);
+            EXPECT_EQ(vitem.borderSize(0), 5);
+            EXPECT_EQ(vitem.borderIndex(0, 3), 3);
+            EXPECT_EQ(vitem.borderSize(1), 1);
+            ASSERT_EQ(vitem.idCount(), 2);
+            EXPECT_EQ(vitem.id(0), i);
+            EXPECT_EQ(vitem.id(1), i + 100);
+
+            ngs::FeatureIDs ids = {i, i + 100, 1000};
+            EXPECT_EQ(vitem.isIdsPresent(ids), true);
+            ids = {i};
+            EXPECT_EQ(vitem.isIdsPresent(ids), false);
+            EXPECT_EQ(vitem.isIdsPresent(ids, false), true);
+            ++i;
+        }
+        EXPECT_EQ(i, 50);
+    }
+}
+
+TEST(GlTests, TestTileBufferCorrupted) {
+    ngs::Envelope extent(10000.0, 60000.0, 30000.0, 80000.0);
+    ngs::VectorTile vtile0;
+    for(GIntBig i = 0; i < 10; ++i) {
+        ngs::VectorTileItem vitem;
+        for(int j = 0; j < 10; ++j) {
+            vitem.addPoint({12345.6f + i * 10 + j, 65432.1f + i * 10 - j});
+        }
+        vitem.addId(i);
+        vitem.setValid(true);
+        vtile0.add(vitem);
+    }
+    ngs::BufferPtr buffer = vtile0.save(extent, false);
+
+    // Magic, flags, origin and quantum, then item count and first item flag
+    const int headerSize = 4 + 1 + 3 * 8;
+    const int pointCountPos = headerSize + 2;
+    std::vector<ngs::BufferPtr> corrupted;
+
+    // Item count far above the tile size
+    ngs::BufferPtr itemCount(new ngs::Buffer);
+    itemCount->put(buffer->data(), headerSize);
+    itemCount->putVarUInt(0xFFFFFFFFFFFFULL);
+    itemCount->put(buffer->data() + headerSize + 1,
+                   static_cast<size_t>(buffer->size() - headerSize - 1));
+    corrupted.push_back(itemCount);
+
+    // Point count of the first item far above the tile size
+    ngs::BufferPtr pointCount(new ngs::Buffer);
+    pointCount->put(buffer->data(), pointCountPos);
+    pointCount->putVarUInt(0xFFFFFFFFFFFFULL);
+    pointCount->put(buffer->data() + pointCountPos + 1,
+                    static_cast<size_t>(buffer->size() - pointCountPos - 1));
+    corrupted.push_back(pointCount);
+
+    for(const ngs::BufferPtr& data : corrupted) {
+        ngs::VectorTile vtile1;
+        data->seek(0);
+        EXPECT_EQ(vtile1.load(*data.get()), false);
+
+        ngs::VectorTileView view;
+        ngs::VectorTileItemView vitem;
+        if(view.load(data)) {
+            EXPECT_EQ(view.next(vitem), false);
+        }
+    }
+}
+
+TEST(GlTests, TestTileDuplicates) {
+    ngs::VectorTile vtile;
+    for(GIntBig i = 0; i < 1000; ++i) {
+        ngs::VectorTileItem vitem;
+        // 100 distinct geometries, each one repeats 10 times
+        int shift = static_cast<int>(i % 100);
+        vitem.addPoint({12345.6f + shift, 65432.1f});
+        vitem.addPoint({12355.6f + shift, 65442.1f});
+        vitem.addId(i);
+        vitem.setValid(true);
+        vtile.add(vitem, true);
+    }
+
+    auto items = vtile.items();
+    ASSERT_EQ(items.size(), 100);
+    for(GIntBig i = 0; i < 100; ++i) {
+        const ngs::VectorTileItem& vitem = items[static_cast<size_t>(i)];
+        EXPECT_EQ(vitem.point(0).x, 12345.6f + i);
+        ngs::FeatureIDs ids;
+        for(GIntBig j = i; j < 1000; j += 100) {
+            ids.insert(j);
+        }
+        EXPECT_EQ(vitem.isIdsPresent(ids), true);
+        EXPECT_EQ(vitem.idsIntesect(ids).size(), 10);
+    }
+
+    // Duplicates are found after remove
+    vtile.remove(0);
+    ngs::VectorTileItem vitem;
+    vitem.addPoint({12346.6f, 65432.1f});
+    vitem.addPoint({12356.6f, 65442.1f});
+    vitem.addId(2000);
+    vitem.setValid(true);
+    vtile.add(vitem, true);
+    EXPECT_EQ(vtile.items().size(), 100);
+}
+
+TEST(GlTests, TestTileRemove) {
+    ngs::VectorTile vtile;
+    for(GIntBig i = 0; i < 100; ++i) {
+        ngs::VectorTileItem vitem;
+        vitem.addPoint({12345.6f + i, 65432.1f});
+        vitem.addId(i);
+        vitem.addId(i + 1000);
+        vitem.setValid(true);
+        vtile.add(vitem);
+    }
+
+    // Item is removed only if all its IDs are removed
+    ngs::FeatureIDs ids = {1, 2, 1002, 1003, 5000};
+    vtile.remove(ids);
+    auto items = vtile.items();
+    ASSERT_EQ(items.size(), 99);
+    EXPECT_EQ(items[1].isIdsPresent({1001}), true);
+    EXPECT_EQ(items[2].point(0).x, 12345.6f + 3);
+    EXPECT_EQ(items[2].isIdsPresent({3}), true);
+
+    // Index is valid after items are erased and added
+    vtile.remove(1001);
+    ngs::VectorTileItem vitem;
+    vitem.addPoint({12345.6f, 65432.1f});
+    vitem.addId(7);
+    vitem.setValid(true);
+    vtile.add(vitem, true);
+    vtile.remove(0);
+    vtile.remove(1000);
+    items = vtile.items();
+    ASSERT_EQ(items.size(), 98);
+    EXPECT_EQ(items[0].isIdsPresent({7}), true);
+}
+
+TEST(GlTests, TestFeatureIDs) {
+    ngs::FeatureIDs ids;
+    EXPECT_EQ(ids.empty(), true);
+    EXPECT_EQ(ids.insert(10), true);
+    EXPECT_EQ(ids.insert(10), false);
+    EXPECT_EQ(ids.size(), 1);
+    EXPECT_EQ(ids.memorySize(), 0);
+
+    ids.insert({30, 5, 20, 5});
+    ASSERT_EQ(ids.size(), 4);
+    std::vector<GIntBig> values(ids.begin(), ids.end());
+    EXPECT_EQ(values, std::vector<GIntBig>({5, 10, 20, 30}));
+    EXPECT_EQ(ids.contains(20), true);
+    EXPECT_EQ(ids.contains(15), false);
+
+    ngs::FeatureIDs other = {1, 20, 40};
+    EXPECT_EQ(ids.intersects(other), true);
+    EXPECT_EQ(ids.includes(other), false);
+    EXPECT_EQ(ids.includes({5, 30}), true);
+    EXPECT_EQ(ids.intersection(other), ngs::FeatureIDs({20}));
+    EXPECT_EQ(ids.intersects({1, 2, 3}), false);
+
+    EXPECT_EQ(ids.erase(15), false);
+    EXPECT_EQ(ids.erase(5), true);
+    EXPECT_EQ(ids.erase(10), true);
+    EXPECT_EQ(ids.erase(20), true);
+    EXPECT_EQ(ids.size(), 1);
+    EXPECT_EQ(*ids.cbegin(), 30);
+    EXPECT_EQ(ids.erase(30), true);
+    EXPECT_EQ(ids.empty(), true);
+}
+
+// Previous per-point implementation with linear duplicate search in rings
+static std::vector<OGRRawPoint> generalizeLineReference(
+        const std::vector<double>& coords, double step, bool isRing)
+{
+    std::vector<OGRRawPoint> parts;
+    OGRRawPoint prevGpoint(ngs::BIG_VALUE, ngs::BIG_VALUE);
+    for(size_t i = 0; i < coords.size() / 2; ++i) {
+        OGRRawPoint gpoint(static_cast<long>(coords[i * 2] / step) * step,
+                           static_cast<long>(coords[i * 2 + 1] / step) * step);
+        if(isRing && std::find_if(parts.begin(), parts.end(),
+                                  [&gpoint](const OGRRawPoint& pt) {
+                return isEqual(pt.x, gpoint.x) &&
+                        isEqual(pt.y, gpoint.y); }) != parts.end()) {
+            continue;
+        }
+        if(isEqual(prevGpoint.x, gpoint.x) &&
+                isEqual(prevGpoint.y, gpoint.y)) {
+            continue;
+        }
+        parts.push_back(gpoint);
+        prevGpoint = gpoint;
+    }
+    return parts;
+}
+
+TEST(GlTests, TestGeneralizeCoordinates) {
+    // Ring of 20k vertices with jitter, so some vertices snap to the same node
+    const size_t count = 20000;
+    std::vector<double> coords;
+    for(size_t i = 0; i < count; ++i) {
+        double angle = 2 * M_PI * i / count;
+        coords.push_back(4000000.0 + 500000.0 * std::cos(angle) + i % 7);
+        coords.push_back(7000000.0 + 500000.0 * std::sin(angle));
+    }
+
+    for(bool isRing : {false, true}) {
+        for(double step : {3.0, 1500.0}) {
+            auto start = std::chrono::steady_clock::now();
+            std::vector<OGRRawPoint> expected =
+                    generalizeLineReference(coords, step, isRing);
+            auto referenceDuration =
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start);
+
+            std::vector<double> result(coords);
+            start = std::chrono::steady_clock::now();
+            size_t size = ngs::generalizeCoordinates(result.data(), count,
+                                                     step, isRing);
+            auto duration =
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start);
+
+            std::cout << "Generalize " << (isRing ? "ring" : "line") <<
+                         " step " << step << ": reference " <<
+                         referenceDuration.count() << " us, kernel " <<
+                         duration.count() << " us\n";
+
+            ASSERT_EQ(size, expected.size());
+            for(size_t i = 0; i < size; ++i) {
+                EXPECT_EQ(result[i * 2], expected[i].x);
+                EXPECT_EQ(result[i * 2 + 1], expected[i].y);
+            }
+        }
+    }
+}
+
+TEST(GlTests, TestFillPolygonTile) {
+    // Polygon with 20k vertices: 16k in exterior ring and 4 holes 1k each.
+    // Triangle vertex indices are 16 bit, so the polygon can't be bigger.
+    const int count = 16000;
+    const int holeCount = 4;
+    const int holePointCount = 1000;
+    OGRPolygon polygon;
+    OGRLinearRing* exteriorRing = new OGRLinearRing;
+    for(int i = 0; i < count; ++i) {
+        double angle = 2 * M_PI * i / count;
+        exteriorRing->addPoint(100000.0 * std::cos(angle),
+                               100000.0 * std::sin(angle));
+    }
+    exteriorRing->closeRings();
+    polygon.addRingDirectly(exteriorRing);
+    for(int i = 0; i < holeCount; ++i) {
+        OGRLinearRing* interiorRing = new OGRLinearRing;
+        double centerX = i % 2 == 0 ? -40000.0 : 40000.0;
+        double centerY = i < 2 ? -40000.0 : 40000.0;
+        for(int j = 0; j < holePointCount; ++j) {
+            double angle = -2 * M_PI * j / holePointCount;
+            interiorRing->addPoint(centerX + 10000.0 * std::cos(angle),
+                                   centerY + 10000.0 * std::sin(angle));
+        }
+        interiorRing->closeRings();
+        polygon.addRingDirectly(interiorRing);
+    }
+
+    ngs::GEOSGeometryWrap geom(&polygon);
+    ngs::VectorTileItemArray items;
+    auto start = std::chrono::steady_clock::now();
+    geom.fillTile(1, items);
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+    std::cout << "Fill polygon tile with " << count + holeCount * holePointCount
+              << " vertices: " << duration.count() << " ms\n";
+
+    ASSERT_EQ(items.size(), 1);
+    const ngs::VectorTileItem& vitem = items[0];
+    EXPECT_EQ(vitem.indices().size() % 3, 0);
+    const auto& borders = vitem.borderIndices();
+    ASSERT_EQ(borders.size(), holeCount + 1);
+    for(int i = 0; i < holeCount + 1; ++i) {
+        const OGRLinearRing* ring = i == 0 ? polygon.getExteriorRing() :
+                                             polygon.getInteriorRing(i - 1);
+        // Each ring point (except the closing one) and the ring closing index
+        ASSERT_EQ(borders[i].size(), ring->getNumPoints());
+        for(int j = 0; j < ring->getNumPoints() - 1; ++j) {
+            const ngs::SimplePoint& pt = vitem.point(borders[i][j]);
+            EXPECT_FLOAT_EQ(pt.x, static_cast<float>(ring->getX(j)));
+            EXPECT_FLOAT_EQ(pt.y, static_cast<float>(ring->getY(j)));
+        }
+        EXPECT_EQ(borders[i].back(), borders[i].front());
+    }
+}
+
 /*
 TEST(GlTests, TestCreate) {
 #ifdef OFFSCREEN_GL
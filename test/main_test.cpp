@@ -21,14 +21,20 @@
 
 #include "test.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <set>
 
 // gdal
 #include "cpl_string.h"
 
 #include "api_priv.h"
+#include "ds/featureclass.h"
 #include "ds/geometry.h"
+#include "ds/simpledataset.h"
+#include "map/maptransform.h"
 #include "ngstore/api.h"
 #include "ngstore/version.h"
 
@@ -447,6 +453,7 @@ TEST(DataStoreTests, TestLoadDataStoreZippedShapefile) {
                                    ngsTestProgressFunc, nullptr), COD_SUCCESS);
     ngsFeatureClassBatchMode(store, 0);
     EXPECT_GE(counter, 1);
+    EXPECT_GE(ngsDatasetSQLLockContentionCount(store), 0);
     ngsUnInit();
 }
 
@@ -652,6 +659,7 @@ TEST(DataStoreTests, TestCreateFeature) {
 
     ngsFeatureClassBatchMode(featureClass, 1);
     EXPECT_EQ(ngsFeatureClassInsertFeature(featureClass, newFeature, 1), COD_SUCCESS);
+    EXPECT_EQ(ngsFeatureClassFlushOverviews(featureClass), COD_SUCCESS);
     ngsFeatureClassBatchMode(featureClass, 0);
 
     ngsFeatureFree(newFeature);
@@ -740,6 +748,78 @@ TEST(DataStoreTests, TestCreateFeature) {
     ngsUnInit();
 }
 
+TEST(DataStoreTests, TestInsertFeatures) {
+    char** options = nullptr;
+    options = ngsAddNameValue(options, "DEBUG_MODE", "ON");
+    options = ngsAddNameValue(options, "SETTINGS_DIR",
+                              ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                              nullptr));
+    EXPECT_EQ(ngsInit(options), COD_SUCCESS);
+
+    ngsListFree(options);
+
+    CPLString catalogPath = ngsCatalogPathFromSystem(ngsGetCurrentDirectory());
+    CPLString fcPath = catalogPath + "/tmp/main.ngst/new_layer";
+    CatalogObjectH featureClass = ngsCatalogObjectGet(fcPath);
+    ASSERT_NE(featureClass, nullptr);
+    long long startCount = ngsFeatureClassCount(featureClass);
+
+    const int featureCount = 100;
+    FeatureH features[featureCount];
+    for(int i = 0; i < featureCount; ++i) {
+        features[i] = ngsFeatureClassCreateFeature(featureClass);
+        ASSERT_NE(features[i], nullptr);
+        GeometryH geom = ngsFeatureCreateGeometry(features[i]);
+        ngsGeometrySetPoint(geom, 0, 37.0 + i * 0.01, 55.0 + i * 0.01, 0.0, 0.0);
+        ngsFeatureSetGeometry(features[i], geom);
+        ngsFeatureSetFieldInteger(features[i], 0, i);
+        ngsStoreFeatureSetRemoteId(features[i], 200000 + i);
+    }
+
+    EXPECT_EQ(ngsFeatureClassInsertFeatures(featureClass, features,
+                                            featureCount, 1), COD_SUCCESS);
+    for(int i = 0; i < featureCount; ++i) {
+        ngsFeatureFree(features[i]);
+    }
+
+    EXPECT_EQ(ngsFeatureClassCount(featureClass), startCount + featureCount);
+
+    FeatureH feature = ngsStoreFeatureClassGetFeatureByRemoteId(featureClass,
+                                                                200050);
+    ASSERT_NE(feature, nullptr);
+    EXPECT_EQ(ngsFeatureGetFieldAsInteger(feature, 0), 50);
+    ngsFeatureFree(feature);
+
+    long long rids[] = {200010, 200011, 200012, 200013, 200014, 1};
+    FeatureH* foundFeatures = ngsStoreFeatureClassGetFeaturesByRemoteIds(
+                featureClass, rids, 6);
+    ASSERT_NE(foundFeatures, nullptr);
+    int foundCount = 0;
+    while(foundFeatures[foundCount] != nullptr) {
+        long long rid = ngsStoreFeatureGetRemoteId(foundFeatures[foundCount]);
+        EXPECT_GE(rid, 200010);
+        EXPECT_LE(rid, 200014);
+        foundCount++;
+    }
+    EXPECT_EQ(foundCount, 5);
+    ngsFeatureListFree(foundFeatures);
+
+    ngsEditOperation* ops = ngsFeatureClassGetEditOperations(featureClass);
+    ASSERT_NE(ops, nullptr);
+    int counter = 0;
+    int createCount = 0;
+    while(ops[counter].fid != -1) {
+        if(ops[counter].code == CC_CREATE_FEATURE) {
+            createCount++;
+        }
+        counter++;
+    }
+    EXPECT_GE(createCount, featureCount);
+    ngsFree(ops);
+
+    ngsUnInit();
+}
+
 TEST(DataStoreTest, TestCreateVectorOverviews) {
     char** options = nullptr;
     options = ngsAddNameValue(options, "DEBUG_MODE", "ON");
@@ -780,6 +860,74 @@ TEST(DataStoreTest, TestCreateVectorOverviews) {
     EXPECT_EQ(VSIStatL(path, &sbuf), 0);
 }
 
+static std::set<ngs::Tile> overviewTiles(ngs::FeatureClass* featureClass,
+                                         unsigned char zoom)
+{
+    std::set<ngs::Tile> out;
+    auto items = ngs::MapTransform::getTilesForExtent(featureClass->extent(),
+                                                      zoom, false, true);
+    for(const auto& item : items) {
+        if(!featureClass->getTile(item.tile).empty()) {
+            out.insert(item.tile);
+        }
+    }
+    return out;
+}
+
+TEST(DataStoreTest, TestCreateVectorOverviewsBottomUp) {
+    char** options = nullptr;
+    options = ngsAddNameValue(options, "DEBUG_MODE", "ON");
+    options = ngsAddNameValue(options, "SETTINGS_DIR",
+                              ngsFormFileName(ngsGetCurrentDirectory(), "tmp",
+                                              nullptr));
+    EXPECT_EQ(ngsInit(options), COD_SUCCESS);
+    ngsListFree(options);
+
+    CPLString catalogPath = ngsCatalogPathFromSystem(ngsGetCurrentDirectory());
+    CPLString cpdShapePath = catalogPath + "/tmp/bld.shp";
+    CatalogObjectH cpdShape = ngsCatalogObjectGet(cpdShapePath);
+    ASSERT_NE(cpdShape, nullptr);
+    ngs::SimpleDataset* dataset = dynamic_cast<ngs::SimpleDataset*>(
+                static_cast<ngs::Object*>(cpdShape));
+    ASSERT_NE(dataset, nullptr);
+    dataset->hasChildren();
+    ngs::FeatureClass* featureClass = ngsDynamicCast(ngs::FeatureClass,
+                                                     dataset->internalObject());
+    ASSERT_NE(featureClass, nullptr);
+
+    const unsigned char zooms[] = {12, 13, 14, 15, 16};
+    options = nullptr;
+    options = ngsAddNameValue(options, "FORCE", "ON");
+    options = ngsAddNameValue(options, "ZOOM_LEVELS", "12,13,14,15,16");
+
+    EXPECT_EQ(ngsFeatureClassCreateOverviews(cpdShape, options,
+                                   ngsTestProgressFunc, nullptr), COD_SUCCESS);
+    std::map<unsigned char, std::set<ngs::Tile>> topDown;
+    for(unsigned char zoom : zooms) {
+        topDown[zoom] = overviewTiles(featureClass, zoom);
+        EXPECT_FALSE(topDown[zoom].empty());
+    }
+
+    options = ngsAddNameValue(options, "BOTTOM_UP", "ON");
+    EXPECT_EQ(ngsFeatureClassCreateOverviews(cpdShape, options,
+                                   ngsTestProgressFunc, nullptr), COD_SUCCESS);
+    ngsListFree(options);
+
+    // The deepest zoom level is tiled the same way in both modes. Coarser
+    // levels are derived from it, so they may only lose collapsed items.
+    for(unsigned char zoom : zooms) {
+        std::set<ngs::Tile> bottomUp = overviewTiles(featureClass, zoom);
+        EXPECT_FALSE(bottomUp.empty());
+        if(zoom == zooms[sizeof(zooms) - 1]) {
+            EXPECT_EQ(bottomUp, topDown[zoom]);
+        }
+        else {
+            EXPECT_TRUE(std::includes(topDown[zoom].begin(),
+                                      topDown[zoom].end(),
+                                      bottomUp.begin(), bottomUp.end()));
+        }
+    }
+}
 
 TEST(DataStoreTest, TestCreateMemoryDatasource) {
     char** options = nullptr;
@@ -21,12 +21,19 @@
 
 #include "test.h"
 
+#include <algorithm>
+#include <atomic>
+
 // gdal
 #include "cpl_conv.h"
 #include "cpl_json.h"
 
 
+#include "api_priv.h"
 #include "ds/datastore.h"
+#include "ds/spatialindex.h"
+#include "util/rwlock.h"
+#include "util/threadpool.h"
 
 static int counter = 0;
 
@@ -71,6 +78,435 @@ TEST(StoreTests, TestJSONSAXPArser) {
     EXPECT_STRNE(ngwVersion, "0");
 }
 
+TEST(StoreTests, TestSpatialIndex) {
+    std::vector<ngs::SpatialIndex::Item> items;
+    for(int x = 0; x < 100; ++x) {
+        for(int y = 0; y < 50; ++y) {
+            ngs::SpatialIndex::Item item = { x * 10.0, y * 10.0,
+                                             x * 10.0 + 5.0, y * 10.0 + 5.0,
+                                             static_cast<GUIntBig>(x * 50 + y) };
+            items.push_back(item);
+        }
+    }
+    std::vector<ngs::SpatialIndex::Item> sourceItems = items;
+
+    ngs::SpatialIndex index;
+    ASSERT_EQ(index.build(items, 12345), true);
+    EXPECT_EQ(index.size(), 5000);
+
+    ngs::Envelope env(102.0, 52.0, 148.0, 78.0);
+    std::vector<GIntBig> expected;
+    for(const auto& item : sourceItems) {
+        if(item.maxX >= env.minX() && item.minX <= env.maxX() &&
+           item.maxY >= env.minY() && item.minY <= env.maxY()) {
+            expected.push_back(static_cast<GIntBig>(item.offset));
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(index.search(env), expected);
+
+    // Stored index is memory mapped
+    CPLString path = CPLGenerateTempFilename("test_ngsidx");
+    ASSERT_EQ(index.save(path), true);
+    ngs::SpatialIndex openIndex;
+    ASSERT_EQ(openIndex.open(path), true);
+    EXPECT_EQ(openIndex.sourceTime(), 12345);
+    EXPECT_EQ(openIndex.search(env), expected);
+    EXPECT_EQ(openIndex.search(ngs::Envelope(2000.0, 2000.0, 3000.0, 3000.0)).size(), 0);
+    VSIUnlink(path);
+}
+
+class TestJobData : public ngs::ThreadData
+{
+public:
+    TestJobData() : ThreadData(true) {}
+};
+
+static std::atomic<int> jobCounter(0);
+
+static bool testJobThreadFunc(ngs::ThreadData* threadData)
+{
+    // Every 10th job fails on first try
+    if(threadData->tries() == 0 && jobCounter++ % 10 == 0) {
+        return false;
+    }
+    return true;
+}
+
+TEST(StoreTests, TestExecutor) {
+    // Nested tasks are not blocked by waiting worker
+    std::atomic<int> sum(0);
+    std::vector<ngs::TaskHandle> handles;
+    for(int i = 0; i < 50; ++i) {
+        handles.push_back(ngs::Executor::instance().submit([&sum]() {
+            std::vector<ngs::TaskHandle> innerHandles;
+            for(int j = 0; j < 10; ++j) {
+                innerHandles.push_back(ngs::Executor::instance().submit(
+                                           [&sum]() { sum++; }));
+            }
+            for(const auto& handle : innerHandles) {
+                handle.wait();
+            }
+        }));
+    }
+    for(const auto& handle : handles) {
+        handle.wait();
+        EXPECT_EQ(handle.isDone(), true);
+    }
+    EXPECT_EQ(sum, 500);
+
+    // Pools share executor workers
+    ngs::ThreadPool pool;
+    pool.init(3, testJobThreadFunc);
+    EXPECT_GE(ngs::Executor::instance().workerCount(), 3);
+    for(int i = 0; i < 1000; ++i) {
+        pool.addThreadData(new TestJobData);
+    }
+    pool.waitComplete(ngs::Progress());
+    EXPECT_EQ(pool.dataCount(), 0);
+    EXPECT_EQ(pool.currentWorkerCount(), 0);
+    EXPECT_GE(jobCounter, 1000);
+}
+
+static bool testSlowJobThreadFunc(ngs::ThreadData* /*threadData*/)
+{
+    CPLSleep(0.005);
+    return true;
+}
+
+TEST(StoreTests, TestThreadPoolYield) {
+    // Pool using all executor workers does not hold them until it is complete
+    unsigned char workerCount = ngs::Executor::instance().workerCount();
+    ngs::ThreadPool pool;
+    pool.init(workerCount, testSlowJobThreadFunc);
+    for(int i = 0; i < workerCount * 64; ++i) {
+        pool.addThreadData(new TestJobData);
+    }
+    ngs::TaskHandle handle = ngs::Executor::instance().submit([]() {});
+    handle.wait();
+    EXPECT_GT(pool.dataCount(), 0);
+    pool.waitComplete(ngs::Progress());
+    EXPECT_EQ(pool.dataCount(), 0);
+}
+
+class TestOrderData : public ngs::ThreadData
+{
+public:
+    TestOrderData(int value, std::vector<int>* order,
+                  const ngs::CancelToken& token) :
+        ThreadData(true), m_value(value), m_order(order), m_token(token) {}
+    virtual bool isCancelled() const override { return m_token.isCancelled(); }
+    int m_value;
+    std::vector<int>* m_order;
+    ngs::CancelToken m_token;
+};
+
+static std::atomic<bool> jobsAdded(false);
+
+static bool testOrderJobThreadFunc(ngs::ThreadData* threadData)
+{
+    TestOrderData* data = static_cast<TestOrderData*>(threadData);
+    // First job holds the only worker until all jobs are queued
+    while(!jobsAdded) {
+        CPLSleep(0.01);
+    }
+    data->m_order->push_back(data->m_value);
+    return true;
+}
+
+TEST(StoreTests, TestThreadPoolPriority) {
+    std::vector<int> order;
+    ngs::CancelToken token, staleToken;
+    ngs::ThreadPool pool;
+    pool.init(1, testOrderJobThreadFunc);
+    pool.addThreadData(new TestOrderData(0, &order, token));
+    int priorities[] = {5, 1, 3, 1, 4};
+    for(int i = 0; i < 5; ++i) {
+        TestOrderData* data = new TestOrderData(i + 1, &order, token);
+        data->setPriority(priorities[i]);
+        pool.addThreadData(data);
+    }
+    TestOrderData* staleData = new TestOrderData(100, &order, staleToken);
+    pool.addThreadData(staleData);
+    staleToken.cancel();
+    jobsAdded = true;
+    pool.waitComplete(ngs::Progress());
+
+    EXPECT_EQ(order, std::vector<int>({0, 2, 4, 3, 5, 1}));
+}
+
+TEST(StoreTests, TestBoundedQueue) {
+    ngs::BoundedQueue<int> queue(4);
+    ngs::TaskHandle handle = ngs::Executor::instance().submit([&queue]() {
+        for(int i = 0; i < 1000; ++i) {
+            queue.push(i);
+        }
+        queue.close();
+    });
+
+    int value = 0, expected = 0;
+    bool ordered = true;
+    while(queue.pop(value)) {
+        ordered = ordered && value == expected;
+        expected++;
+    }
+    handle.wait();
+    EXPECT_EQ(ordered, true);
+    EXPECT_EQ(expected, 1000);
+
+    // Closed queue does not accept items
+    EXPECT_EQ(queue.push(1), false);
+    EXPECT_EQ(queue.pop(value), false);
+}
+
+TEST(StoreTests, TestReadWriteLock) {
+    ngs::ReadWriteLock lock;
+
+    // Readers do not block each other
+    std::atomic<int> readers(0);
+    lock.lockShared();
+    ngs::TaskHandle handle = ngs::Executor::instance().submit([&]() {
+        ngs::ReadWriteLockHolder holder(&lock, true);
+        readers++;
+    });
+    handle.wait();
+    EXPECT_EQ(readers, 1);
+    // Recursive shared ownership, upgrade to exclusive one fails
+    lock.lockShared();
+    EXPECT_EQ(lock.lock(), false);
+    lock.unlockShared();
+    lock.unlockShared();
+    // Recursive exclusive ownership and shared ownership taken by the owner
+    lock.lock();
+    lock.lock();
+    lock.lockShared();
+    lock.unlockShared();
+    lock.unlock();
+    lock.unlock();
+    EXPECT_EQ(lock.contentionCount(), 0);
+
+    // Writer excludes readers
+    lock.lock();
+    handle = ngs::Executor::instance().submit([&]() {
+        ngs::ReadWriteLockHolder holder(&lock, true);
+        readers++;
+    });
+    CPLSleep(0.2);
+    EXPECT_EQ(readers, 1);
+    lock.unlock();
+    handle.wait();
+    EXPECT_EQ(readers, 2);
+    EXPECT_EQ(lock.contentionCount(), 1);
+    lock.resetContentionCount();
+    EXPECT_EQ(lock.contentionCount(), 0);
+}
+
+static ngs::ObjectPtr createCursorTestStore(const char* name, int rowCount) {
+    OGRRegisterAll();
+    VSIMkdir("tmp", 0755);
+    CPLString path = CPLFormFilename("tmp", name,
+                                     ngs::DataStore::extension());
+    VSIUnlink(path);
+    if(!ngs::DataStore::create(path)) {
+        return ngs::ObjectPtr();
+    }
+    ngs::ObjectPtr store(new ngs::DataStore(nullptr, name, path));
+    ngs::DataStore* dataStore = ngsDynamicCast(ngs::DataStore, store);
+    if(!dataStore->open(GDAL_OF_SHARED|GDAL_OF_UPDATE)) {
+        return ngs::ObjectPtr();
+    }
+
+    ngs::Options options;
+    options.addOption("FIELD_COUNT", "1");
+    options.addOption("FIELD_0_TYPE", "INTEGER");
+    options.addOption("FIELD_0_NAME", "val");
+    if(!dataStore->create(CAT_TABLE_GPKG, "cursor_values", options)) {
+        return ngs::ObjectPtr();
+    }
+    ngs::TablePtr table = std::dynamic_pointer_cast<ngs::Table>(
+                dataStore->getChild("cursor_values"));
+    if(!table) {
+        return ngs::ObjectPtr();
+    }
+
+    std::vector<ngs::FeaturePtr> features;
+    for(int i = 0; i < rowCount; ++i) {
+        ngs::FeaturePtr feature = table->createFeature();
+        feature->SetField("val", i);
+        features.push_back(feature);
+    }
+    if(!table->insertFeatures(features, false)) {
+        return ngs::ObjectPtr();
+    }
+    return store;
+}
+
+static int readCursor(const ngs::FeatureCursorPtr& cursor, int minValue,
+                      int maxValue) {
+    int count = 0;
+    ngs::FeaturePtr feature;
+    while((feature = cursor->next())) {
+        int value = feature->GetFieldAsInteger("val");
+        if(value < minValue || value > maxValue) {
+            return -1;
+        }
+        count++;
+    }
+    return count;
+}
+
+TEST(StoreTests, TestConcurrentCursors) {
+    ngs::ObjectPtr store = createCursorTestStore("cursors", 1000);
+    ASSERT_NE(store, nullptr);
+    ngs::DataStore* dataStore = ngsDynamicCast(ngs::DataStore, store);
+    ngs::TablePtr table = std::dynamic_pointer_cast<ngs::Table>(
+                dataStore->getChild("cursor_values"));
+    ASSERT_NE(table, nullptr);
+
+    // Cursors have own filters and read at the same time
+    ngs::FeatureCursorPtr low = table->openCursor("val < 500");
+    ngs::FeatureCursorPtr high = table->openCursor("val >= 800");
+    ASSERT_NE(low, nullptr);
+    ASSERT_NE(high, nullptr);
+    int highCount = 0;
+    ngs::TaskHandle handle = ngs::Executor::instance().submit([&]() {
+        highCount = readCursor(high, 800, 999);
+    });
+    int lowCount = readCursor(low, 0, 499);
+    handle.wait();
+    EXPECT_EQ(lowCount, 500);
+    EXPECT_EQ(highCount, 200);
+    EXPECT_EQ(low->count(), 500);
+    EXPECT_EQ(high->count(), 200);
+
+    // Table itself is not filtered by cursors
+    low.reset();
+    high.reset();
+    EXPECT_EQ(table->featureCount(true), 1000);
+}
+
+TEST(StoreTests, TestReadHandles) {
+    ngs::ObjectPtr store = createCursorTestStore("handles", 10);
+    ASSERT_NE(store, nullptr);
+    ngs::DataStore* dataStore = ngsDynamicCast(ngs::DataStore, store);
+    ngs::TablePtr table = std::dynamic_pointer_cast<ngs::Table>(
+                dataStore->getChild("cursor_values"));
+    ASSERT_NE(table, nullptr);
+
+    // Released handle is reused
+    GDALDataset* handle = dataStore->acquireReadHandle();
+    ASSERT_NE(handle, nullptr);
+    dataStore->releaseReadHandle(handle);
+    GDALDataset* reused = dataStore->acquireReadHandle();
+    EXPECT_EQ(reused, handle);
+
+    // Handles opened before the schema change are not reused
+    GDALDataset* pooled = dataStore->acquireReadHandle();
+    ASSERT_NE(pooled, nullptr);
+    dataStore->releaseReadHandle(pooled);
+    ASSERT_TRUE(table->destroy());
+    table.reset();
+
+    ngs::Options options;
+    options.addOption("FIELD_COUNT", "1");
+    options.addOption("FIELD_0_TYPE", "INTEGER");
+    options.addOption("FIELD_0_NAME", "val");
+    ASSERT_TRUE(dataStore->create(CAT_TABLE_GPKG, "new_values", options));
+    dataStore->releaseReadHandle(reused);
+
+    // New handle knows the new table and does not know the destroyed one
+    GDALDataset* fresh = dataStore->acquireReadHandle();
+    ASSERT_NE(fresh, nullptr);
+    EXPECT_EQ(fresh->GetLayerByName("cursor_values"), nullptr);
+    EXPECT_NE(fresh->GetLayerByName("new_values"), nullptr);
+    dataStore->releaseReadHandle(fresh);
+
+    // Cursor of the new table reads through the pooled handle
+    ngs::TablePtr newTable = std::dynamic_pointer_cast<ngs::Table>(
+                dataStore->getChild("new_values"));
+    ASSERT_NE(newTable, nullptr);
+    ngs::FeaturePtr feature = newTable->createFeature();
+    feature->SetField("val", 1);
+    ASSERT_TRUE(newTable->insertFeature(feature, false));
+    ngs::FeatureCursorPtr cursor = newTable->openCursor();
+    ASSERT_NE(cursor, nullptr);
+    EXPECT_EQ(readCursor(cursor, 1, 1), 1);
+}
+
+static void logTestOp(ngs::EditHistory& history, OGRLayer* layer, GIntBig fid,
+                      GIntBig aid, enum ngsChangeCode code) {
+    ngs::FeaturePtr op = OGRFeature::CreateFeature(layer->GetLayerDefn());
+    op->SetField(ngs::FEATURE_ID_FIELD, fid);
+    op->SetField(ngs::ATTACH_FEATURE_ID_FIELD, aid);
+    op->SetField(ngs::OPERATION_FIELD, code);
+    history.log(op);
+}
+
+TEST(StoreTests, TestEditHistory) {
+    OGRRegisterAll();
+    GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("Memory");
+    ASSERT_NE(driver, nullptr);
+    GDALDataset* DS = driver->Create("history", 0, 0, 0, GDT_Unknown, nullptr);
+    ASSERT_NE(DS, nullptr);
+    OGRLayer* layer = DS->CreateLayer("history", nullptr, wkbNone, nullptr);
+    OGRFieldDefn fid(ngs::FEATURE_ID_FIELD, OFTInteger64);
+    OGRFieldDefn aid(ngs::ATTACH_FEATURE_ID_FIELD, OFTInteger64);
+    OGRFieldDefn op(ngs::OPERATION_FIELD, OFTInteger);
+    layer->CreateField(&fid);
+    layer->CreateField(&aid);
+    layer->CreateField(&op);
+
+    ngs::EditHistory history;
+    ASSERT_TRUE(history.load(layer));
+    logTestOp(history, layer, 1, -1, CC_CREATE_FEATURE);
+    logTestOp(history, layer, 1, -1, CC_CHANGE_FEATURE);
+    logTestOp(history, layer, 2, -1, CC_CHANGE_FEATURE);
+    logTestOp(history, layer, 3, -1, CC_CREATE_FEATURE);
+    logTestOp(history, layer, 3, 7, CC_CREATE_ATTACHMENT);
+    logTestOp(history, layer, 3, 7, CC_DELETE_ATTACHMENT);
+    logTestOp(history, layer, 1, -1, CC_DELETE_FEATURE);
+    history.flush(layer);
+    EXPECT_EQ(history.pendingCount(), 0u);
+    EXPECT_EQ(layer->GetFeatureCount(), 2);
+
+    // Change of stored rows
+    logTestOp(history, layer, 2, -1, CC_DELETE_FEATURE);
+    logTestOp(history, layer, 3, -1, CC_DELETE_FEATURE);
+    history.flush(layer);
+
+    std::vector<std::pair<GIntBig, int>> ops;
+    ngs::FeaturePtr feature;
+    layer->ResetReading();
+    while((feature = layer->GetNextFeature())) {
+        ops.push_back(std::make_pair(
+                          feature->GetFieldAsInteger64(ngs::FEATURE_ID_FIELD),
+                          feature->GetFieldAsInteger(ngs::OPERATION_FIELD)));
+    }
+    ASSERT_EQ(ops.size(), 1u);
+    EXPECT_EQ(ops[0].first, 2);
+    EXPECT_EQ(ops[0].second, CC_DELETE_FEATURE);
+
+    // Reloaded history continues from stored rows
+    ASSERT_TRUE(history.load(layer));
+    logTestOp(history, layer, -1, -1, CC_DELETEALL_FEATURES);
+    logTestOp(history, layer, 4, -1, CC_CREATE_FEATURE);
+    ASSERT_TRUE(history.isCleared());
+    // Table clears stored rows with one statement before flush
+    layer->ResetReading();
+    while((feature = layer->GetNextFeature())) {
+        layer->DeleteFeature(feature->GetFID());
+    }
+    history.flush(layer);
+    ASSERT_EQ(layer->GetFeatureCount(), 1);
+    layer->ResetReading();
+    feature = layer->GetNextFeature();
+    EXPECT_EQ(feature->GetFieldAsInteger64(ngs::FEATURE_ID_FIELD), 4);
+    EXPECT_EQ(feature->GetFieldAsInteger(ngs::OPERATION_FIELD),
+              CC_CREATE_FEATURE);
+
+    GDALClose(DS);
+}
+
 /*
 TEST(StoreTests, TestCreate) {
     EXPECT_EQ(ngsInit(nullptr, nullptr), ngsErrorCodes::EC_SUCCESS);